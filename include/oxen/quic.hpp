@@ -1,7 +1,9 @@
 #pragma once
 
 #include "quic/address.hpp"
+#include "quic/btchannel.hpp"
 #include "quic/btstream.hpp"
+#include "quic/btworkers.hpp"
 #include "quic/connection.hpp"
 #include "quic/connection_ids.hpp"
 #include "quic/context.hpp"
@@ -20,6 +22,7 @@
 #include "quic/network.hpp"
 #include "quic/opt.hpp"
 #include "quic/stream.hpp"
+#include "quic/stream_slice.hpp"
 #include "quic/types.hpp"
 #include "quic/udp.hpp"
 #include "quic/utils.hpp"
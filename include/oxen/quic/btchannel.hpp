@@ -0,0 +1,94 @@
+#pragma once
+
+#include "btstream.hpp"
+
+namespace oxen::quic
+{
+    /** BTRequestChannel:
+            Spreads the BT requests made over a connection across a pool of BTRequestStreams, so
+        that a large request or response only holds up the requests that share its stream rather
+        than every request on the connection.  Requests expecting a response whose body is at least
+        `dedicated_threshold` bytes, and any request made with `command_dedicated` (e.g. requests
+        expecting a large response), get a stream of their own that is closed once the request has
+        been answered or has timed out.
+
+        All of the channel's streams share the channel's request id space and handler router (used
+        for requests initiated by the remote on those streams); each stream times out its own
+        requests.  The remote side must construct its incoming streams as BTRequestStreams, for
+        instance by listening with the constructor callback from `stream_constructor()`.
+     */
+    class BTRequestChannel
+    {
+      public:
+        static constexpr size_t DEFAULT_POOL_SIZE = 4;
+        static constexpr size_t DEFAULT_DEDICATED_THRESHOLD = 64_ki;
+
+        /// Opens the pool of `pool_size` streams on `conn`.  Throws std::invalid_argument if
+        /// `pool_size` is 0.
+        explicit BTRequestChannel(
+                std::shared_ptr<connection_interface> conn,
+                std::shared_ptr<const bt_router> router = nullptr,
+                size_t pool_size = DEFAULT_POOL_SIZE,
+                size_t dedicated_threshold = DEFAULT_DEDICATED_THRESHOLD);
+
+        BTRequestChannel(const BTRequestChannel&) = delete;
+        BTRequestChannel& operator=(const BTRequestChannel&) = delete;
+
+        /// Closes the pooled streams.  Dedicated streams close themselves once their request is
+        /// done.
+        ~BTRequestChannel();
+
+        /// Sends a request on the next pooled stream (or on a dedicated stream, for large bodies).
+        /// Takes the same options as BTRequestStream::command.
+        template <typename... Opt>
+        bt_request_handle command(std::string ep, bstring_view body, Opt&&... opts)
+        {
+            if constexpr (expects_response<Opt...>)
+                if (body.size() >= dedicated_threshold)
+                    return command_dedicated(std::move(ep), body, std::forward<Opt>(opts)...);
+
+            return next_stream().command(std::move(ep), body, std::forward<Opt>(opts)...);
+        }
+        template <typename... Opt>
+        bt_request_handle command(std::string ep, std::string_view body, Opt&&... opts)
+        {
+            return command(std::move(ep), convert_sv<std::byte>(body), std::forward<Opt>(opts)...);
+        }
+
+        /// Sends a request on a newly opened stream of its own, which is closed once the response
+        /// (or timeout) has been delivered.  A response callback is required.
+        template <typename... Opt>
+        bt_request_handle command_dedicated(std::string ep, bstring_view body, Opt&&... opts)
+        {
+            static_assert(expects_response<Opt...>, "dedicated channel requests require a response callback");
+            return open_dedicated()->command(std::move(ep), body, std::forward<Opt>(opts)...);
+        }
+        template <typename... Opt>
+        bt_request_handle command_dedicated(std::string ep, std::string_view body, Opt&&... opts)
+        {
+            return command_dedicated(std::move(ep), convert_sv<std::byte>(body), std::forward<Opt>(opts)...);
+        }
+
+        const std::vector<std::shared_ptr<BTRequestStream>>& streams() const { return pool; }
+
+        /// Returns a stream constructor callback that constructs every incoming stream as a
+        /// BTRequestStream using `router`, suitable for the remote side of a channel.
+        static stream_constructor_callback stream_constructor(std::shared_ptr<const bt_router> router = nullptr);
+
+      private:
+        template <typename... Opt>
+        static constexpr bool expects_response = (std::is_constructible_v<std::function<void(message)>, Opt> || ...);
+
+        std::shared_ptr<connection_interface> conn;
+        std::shared_ptr<const bt_router> router;
+        const size_t dedicated_threshold;
+
+        std::shared_ptr<std::atomic<int64_t>> rids = std::make_shared<std::atomic<int64_t>>(0);
+        std::vector<std::shared_ptr<BTRequestStream>> pool;
+        std::atomic<size_t> next{0};
+
+        BTRequestStream& next_stream() { return *pool[next++ % pool.size()]; }
+
+        std::shared_ptr<BTRequestStream> open_dedicated();
+    };
+}  // namespace oxen::quic
@@ -1,5 +1,10 @@
+#pragma once
+
 #include <oxenc/bt.h>
 
+#include <set>
+
+#include "btworkers.hpp"
 #include "endpoint.hpp"
 #include "stream.hpp"
 #include "utils.hpp"
@@ -19,6 +24,8 @@ namespace oxen::quic
     inline constexpr size_t MAX_REQ_LEN_ENCODED = 9;  // "10000000:"
 
     class BTRequestStream;
+    class bt_chunk_writer;
+    class bt_batch;
 
     // Exception type to throw from a handler to have a method-not-found error returned as a
     // response to the message.  The `what()` value is not actually used: we send back a string that
@@ -37,16 +44,28 @@ namespace oxen::quic
 
       private:
         int64_t req_id;
+
+        // The encoded request is held in exactly one of these: `slice` when the stream parses in
+        // place (see opt::bt_parse_in_place) and the request arrived complete within a single chunk
+        // of stream data (in which case it references the data in place in the stream's receive
+        // buffer, without copying), and `data` otherwise.  Note that holding on to a
+        // slice-backed message also holds back the stream flow control credit of the data it
+        // references until the message is destroyed.
         bstring data;
+        stream_slice slice;
 
-        // We keep the locations of variables fields as relative positions inside `data` *rather*
-        // than using std::string_view members because the string_views are more difficult to
-        // maintain when the object gets moved or copied.
+        // We keep the locations of variables fields as relative positions inside the request data
+        // *rather* than using std::string_view members because the string_views are more difficult
+        // to maintain when the object gets moved or copied.
         using substr_location = std::pair<std::ptrdiff_t, std::size_t>;
         substr_location req_type{};
         substr_location ep{};
         substr_location req_body{};
 
+        // Set for the pieces of a streamed (chunked) command or response: see `is_chunk()`
+        bool _chunk{false};
+        bool _last{true};
+
         std::weak_ptr<BTRequestStream> return_sender;
         ConnectionID _rid;
 
@@ -55,14 +74,59 @@ namespace oxen::quic
         //   requested timeout in cases where we detect early that the response cannot arrive, such
         //   as the connection closing.
         message(BTRequestStream& bp, bstring req, bool is_timeout = false);
+        message(BTRequestStream& bp, stream_slice req);
+
+        void parse();
+
+        const std::byte* base() const { return slice.empty() ? data.data() : slice.data(); }
+        size_t size() const { return slice.empty() ? data.size() : slice.size(); }
 
       public:
         inline static constexpr auto TYPE_REPLY = "R"sv;
         inline static constexpr auto TYPE_ERROR = "E"sv;
         inline static constexpr auto TYPE_COMMAND = "C"sv;
+        // Types of the messages making up a streamed command or response (see `is_chunk()`)
+        inline static constexpr auto TYPE_COMMAND_CHUNK = "c"sv;
+        inline static constexpr auto TYPE_REPLY_CHUNK = "r"sv;
+        // Sent (with no body) to tell the remote that we are no longer interested in the response
+        // to one of our requests
+        inline static constexpr auto TYPE_CANCEL = "X"sv;
+
+        // If `keep_alive` is given it must keep `body` alive until it has been sent, and the body is
+        // sent without copying it.
+        void respond(bstring_view body, bool error = false, std::shared_ptr<void> keep_alive = nullptr) const;
+        void respond(std::string_view body, bool error = false, std::shared_ptr<void> keep_alive = nullptr) const
+        {
+            respond(convert_sv<std::byte>(body), error, std::move(keep_alive));
+        }
 
-        void respond(bstring_view body, bool error = false) const;
-        void respond(std::string_view body, bool error = false) const { respond(convert_sv<std::byte>(body), error); }
+        // Starts a streamed response to this message, with a body of unlimited total size sent as a
+        // sequence of chunks through the returned writer.  (An error response can still be sent
+        // with `respond(..., true)`, or the writer's `fail()`, at any point to end the response.)
+        bt_chunk_writer respond_stream() const;
+
+        // Streamed messages:
+        //     A streamed command or response is delivered to the endpoint handler or response
+        // callback as a sequence of messages, one per chunk, each with `is_chunk()` true and the
+        // chunk as its body; the last one has `is_last()` true.  Each chunk (rather than the whole
+        // message) is subject to MAX_REQ_LEN, so the total size is unlimited.  On a stream that
+        // parses in place, incoming chunks reference the stream's receive buffer, so a handler that
+        // holds on to chunks it has not yet consumed holds back the stream's flow control credit;
+        // `stream()->pause()` and `resume()` can also be used to stop and restart the incoming flow
+        // explicitly.
+        bool is_chunk() const { return _chunk; }
+        bool is_last() const { return _last; }
+
+        // Cancellation:
+        //     The requester of a command can cancel it (see `bt_request_handle`), and requests that
+        // time out are cancelled if the requester's stream was constructed with
+        // `opt::bt_cancel_on_timeout`.  A handler still working on a request (e.g. on a
+        // worker pool, or after deferring its response) can poll `cancelled()`, or register a
+        // callback with `on_cancel()`, to stop work that nobody is waiting for any more.  The
+        // callback is invoked on the event loop when the cancellation arrives, or immediately if it
+        // already has; it is dropped once the request has been responded to.
+        bool cancelled() const;
+        void on_cancel(std::function<void()> cb) const;
 
         const bool timed_out{false};
         bool is_error() const { return type() == TYPE_ERROR; }
@@ -83,21 +147,21 @@ namespace oxen::quic
         template <oxenc::basic_char Char = char>
         std::basic_string_view<Char> view() const
         {
-            return {reinterpret_cast<const Char*>(data.data()), data.size()};
+            return {reinterpret_cast<const Char*>(base()), size()};
         }
 
         int64_t rid() const { return req_id; }
         std::string_view type() const
         {
-            return {reinterpret_cast<const char*>(data.data()) + req_type.first, req_type.second};
+            return {reinterpret_cast<const char*>(base()) + req_type.first, req_type.second};
         }
-        std::string_view endpoint() const { return {reinterpret_cast<const char*>(data.data()) + ep.first, ep.second}; }
+        std::string_view endpoint() const { return {reinterpret_cast<const char*>(base()) + ep.first, ep.second}; }
         std::string endpoint_str() const { return std::string{endpoint()}; }
 
         template <oxenc::basic_char Char = char>
         std::basic_string_view<Char> body() const
         {
-            return {reinterpret_cast<const Char*>(data.data()) + req_body.first, req_body.second};
+            return {reinterpret_cast<const Char*>(base()) + req_body.first, req_body.second};
         }
 
         template <oxenc::basic_char Char = char>
@@ -117,11 +181,113 @@ namespace oxen::quic
         }
     };
 
+    /** bt_chunk_writer:
+            Sends the body of a streamed command (from `BTRequestStream::command_stream`) or
+        response (from `message::respond_stream`) as a sequence of chunks, each of which is
+        delivered to the remote handler or response callback as it arrives.  Chunks are queued on
+        the stream as they are written; writers of large bodies should pace themselves with
+        `when_writable()`, writing the next chunk as earlier ones are delivered, rather than writing
+        everything at once.
+
+        The message ends with `finish()` (or `fail()`, for a response); a writer destroyed without
+        having finished finishes the message with an empty final chunk.
+     */
+    class bt_chunk_writer
+    {
+        friend class BTRequestStream;
+        friend struct message;
+
+        std::weak_ptr<BTRequestStream> stream;
+        int64_t rid;
+        std::optional<std::string> ep;  // set for commands
+        bool _finished{false};
+
+        bt_chunk_writer(std::weak_ptr<BTRequestStream> s, int64_t rid, std::optional<std::string> ep = std::nullopt) :
+                stream{std::move(s)}, rid{rid}, ep{std::move(ep)}
+        {}
+
+        void send(bstring_view chunk, std::shared_ptr<void> keep_alive, bool fin);
+
+      public:
+        bt_chunk_writer(bt_chunk_writer&& w) noexcept;
+        bt_chunk_writer& operator=(bt_chunk_writer&&) = delete;
+        ~bt_chunk_writer();
+
+        // Default `low_water` of `when_writable()`
+        static constexpr size_t DEFAULT_LOW_WATER = 1_Mi;
+
+        int64_t request_id() const { return rid; }
+        bool finished() const { return _finished; }
+
+        /// Invokes `cb` (on the event loop) once no more than `low_water` bytes sent on the stream
+        /// remain unacknowledged, or as soon as possible if that is already the case.  The callback
+        /// is dropped if the stream closes first.  Throws std::logic_error if the message has
+        /// already been finished.
+        void when_writable(std::function<void()> cb, size_t low_water = DEFAULT_LOW_WATER);
+
+        /// Sends the next chunk.  If `keep_alive` is given it must keep `chunk` alive until sent,
+        /// and the chunk is sent without being copied.  Throws std::logic_error if the message has
+        /// already been finished, or std::invalid_argument if the chunk exceeds MAX_REQ_LEN.
+        void write(bstring_view chunk, std::shared_ptr<void> keep_alive = nullptr);
+        void write(std::string_view chunk, std::shared_ptr<void> keep_alive = nullptr)
+        {
+            write(convert_sv<std::byte>(chunk), std::move(keep_alive));
+        }
+
+        /// Sends the final chunk (which may be empty), ending the message.
+        void finish(bstring_view chunk = {}, std::shared_ptr<void> keep_alive = nullptr);
+        void finish(std::string_view chunk, std::shared_ptr<void> keep_alive = nullptr)
+        {
+            finish(convert_sv<std::byte>(chunk), std::move(keep_alive));
+        }
+
+        /// Ends a streamed response with an error response carrying `body`.  Throws
+        /// std::logic_error if used for a streamed command.
+        void fail(bstring_view body);
+        void fail(std::string_view body) { fail(convert_sv<std::byte>(body)); }
+    };
+
+    /** bt_request_handle:
+            Returned by `BTRequestStream::command` (and friends) to allow the request to be cancelled
+        later.  A default-constructed handle refers to no request.
+     */
+    class bt_request_handle
+    {
+        friend class BTRequestStream;
+        friend class bt_batch;
+
+        std::weak_ptr<BTRequestStream> stream;
+        int64_t rid{-1};
+
+        bt_request_handle(std::weak_ptr<BTRequestStream> s, int64_t rid) : stream{std::move(s)}, rid{rid} {}
+
+      public:
+        bt_request_handle() = default;
+
+        int64_t request_id() const { return rid; }
+
+        /// Cancels the request, if it is still awaiting its response: its response callback will
+        /// not be invoked, and the remote is sent a cancellation so that its handler can stop
+        /// working on it.  Does nothing if the response (or timeout) has already been delivered.
+        /// As with `opt::bt_cancel_on_timeout`, the remote must be one that understands
+        /// cancellations.
+        void cancel();
+    };
+
     struct sent_request
     {
+        // The terminator of the bt-encoded request list, sent after the body
+        inline static constexpr auto TRAILER = "e"_bsv;
+
         // parsed request data
         int64_t req_id;
-        std::string data;
+        // The bt-encoded length prefix and request list up to and including the body's length
+        // prefix (e.g. "27:l1:Ci0e4:ping11:"), which is followed on the wire by the body itself and
+        // then the TRAILER.  The body is not copied into the encoded request: it is sent as its own
+        // segment, kept alive by `keep_alive` (or by a copy, if no keep-alive was given).
+        std::string header;
+        bstring_view body;
+        std::shared_ptr<void> keep_alive;
         std::function<void(message)> cb = nullptr;
         BTRequestStream& return_sender;
 
@@ -132,14 +298,19 @@ namespace oxen::quic
         time_point expiry;
         std::optional<std::chrono::milliseconds> timeout;
 
-        bool is_empty() const { return data.empty() && total_len == 0; }
+        // The expiry of a streamed command whose body is still being written: its timeout only
+        // starts once the body is finished.
+        static constexpr time_point NO_EXPIRY = time_point::max();
+
+        bool is_empty() const { return header.empty() && total_len == 0; }
 
         template <typename... Opt>
-        sent_request(BTRequestStream& bp, std::string_view d, int64_t rid, Opt&&... opts) :
+        sent_request(BTRequestStream& bp, std::string hdr, bstring_view b, int64_t rid, Opt&&... opts) :
                 req_id{rid},
-                data{oxenc::bt_serialize(d)},
+                header{std::move(hdr)},
+                body{b},
                 return_sender{bp},
-                total_len{data.size()},
+                total_len{header.size() + body.size() + TRAILER.size()},
                 req_time{get_time()},
                 expiry{req_time}
         {
@@ -148,15 +319,32 @@ namespace oxen::quic
 
             ((void)handle_req_opts(std::forward<Opt>(opts)), ...);
             expiry += timeout.value_or(DEFAULT_TIMEOUT);
+
+            if (!keep_alive && !body.empty())
+            {
+                auto copy = std::make_shared<bstring>(body);
+                body = *copy;
+                keep_alive = std::move(copy);
+            }
         }
 
         bool is_expired(time_point now) const { return expiry < now; }
 
+        // Moves the encoded request out into the segments to be sent on the wire, along with a
+        // keep-alive that owns the header and holds on to the body.
+        std::pair<std::vector<bstring_view>, std::shared_ptr<void>> wire() &&
+        {
+            auto ka = std::make_shared<std::pair<std::string, std::shared_ptr<void>>>(
+                    std::move(header), std::move(keep_alive));
+            return {{convert_sv<std::byte>(std::string_view{ka->first}), body, TRAILER}, std::move(ka)};
+        }
+
         message to_timeout() && { return {return_sender, ""_bs, true}; }
 
       private:
         void handle_req_opts(std::function<void(message)> func) { cb = std::move(func); }
         void handle_req_opts(std::chrono::milliseconds exp) { timeout = exp; }
+        void handle_req_opts(std::shared_ptr<void> ka) { keep_alive = std::move(ka); }
 
         template <typename Opt>
         void handle_req_opts(std::optional<Opt> option)
@@ -166,17 +354,149 @@ namespace oxen::quic
         }
     };
 
+    namespace detail
+    {
+        // Transparent string hasher so that maps keyed by std::string can be searched with a
+        // string_view without constructing a temporary std::string
+        struct string_hash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+    }  // namespace detail
+
+    /** bt_router:
+            Immutable table of request endpoint handlers that is built once, after all endpoints are
+        known, and can then be shared by any number of BTRequestStreams (e.g. every stream of an
+        Endpoint) rather than having each stream set up its own handlers via `register_handler`.
+        Endpoints are kept in a sorted, flat table so that dispatching an incoming request is a
+        binary search over string_views that never allocates.
+
+        Handlers found in the router are used when the stream has no `register_handler` handler for
+        the endpoint, and before falling back to the stream's generic handler.
+     */
+    class bt_router
+    {
+      public:
+        using handler = std::function<void(message)>;
+
+        // Throws std::invalid_argument if the same endpoint is given more than once, or if a
+        // handler is empty.
+        explicit bt_router(std::vector<std::pair<std::string, handler>> endpoints);
+
+        // Returns the handler for endpoint `ep`, or nullptr if there is no such endpoint
+        const handler* find(std::string_view ep) const;
+
+        // Same as `find`, but returns the whole (endpoint, handler) table entry
+        const std::pair<std::string, handler>* find_entry(std::string_view ep) const;
+
+        size_t size() const { return table.size(); }
+
+      private:
+        std::vector<std::pair<std::string, handler>> table;
+    };
+
+    /** bt_batch:
+            Collects commands to be sent together (see `BTRequestStream::batch`).  All of the
+        commands are encoded into one contiguous buffer, which the stream sends with a single send
+        (and a single trip into the event loop).
+     */
+    class bt_batch
+    {
+        friend class BTRequestStream;
+
+        BTRequestStream& stream;
+        std::shared_ptr<bstring> buf = std::make_shared<bstring>();
+        std::vector<std::shared_ptr<sent_request>> requests;
+        size_t count{0};
+
+        explicit bt_batch(BTRequestStream& s) : stream{s} {}
+
+      public:
+        /// Adds a command to the batch; takes the same options as `BTRequestStream::command`
+        /// (except that a keep-alive is pointless, since the body is copied into the batch).
+        template <typename... Opt>
+        bt_request_handle command(std::string_view ep, bstring_view body, Opt&&... opts);
+        template <typename... Opt>
+        bt_request_handle command(std::string_view ep, std::string_view body, Opt&&... opts)
+        {
+            return command(ep, convert_sv<std::byte>(body), std::forward<Opt>(opts)...);
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
     class BTRequestStream : public Stream
     {
         friend class TestHelper;
 
       private:
-        // outgoing requests awaiting response
+        // outgoing requests awaiting response, by request id
         // We use shared_ptr's so we can lambda capture it, though it is not actually shared
-        std::deque<std::shared_ptr<sent_request>> sent_reqs;
-
-        std::unordered_map<std::string, std::function<void(message)>> func_map;
-        std::function<void(message)> generic_handler;
+        std::unordered_map<int64_t, std::shared_ptr<sent_request>> sent_reqs;
+
+        // The (expiry, request id) of every request in `sent_reqs`, in expiry order.  The timeout
+        // timer is kept armed for the earliest of these, so that requests time out when they are
+        // due without any periodic scanning.
+        std::set<std::pair<time_point, int64_t>> deadlines;
+        event_ptr timeout_timer;
+
+        // Handlers are held by shared_ptr so that a request queued on the worker pool can hold on
+        // to its handler without copying it, even if the handler is replaced in the meantime.
+        using handler_ptr = std::shared_ptr<const std::function<void(message)>>;
+        std::unordered_map<std::string, handler_ptr, detail::string_hash, std::equal_to<>> func_map;
+        std::shared_ptr<const bt_router> router;
+        handler_ptr generic_handler;
+
+        // Set if request handlers run on a worker pool rather than on the event loop; `strand`
+        // keeps this stream's requests in order on the pool.
+        std::shared_ptr<bt_worker_pool> workers;
+        std::shared_ptr<detail::bt_strand> strand;
+
+        // One or more encoded messages to be sent from the event loop, along with the requests (if
+        // any) among them that are to be registered to await a response before sending
+        struct queued_send
+        {
+            std::vector<bstring_view> bufs;
+            std::shared_ptr<void> keep_alive;
+            std::vector<std::shared_ptr<sent_request>> requests;
+            size_t messages{1};
+        };
+
+        // Messages sent from outside the event loop (or, when auto-corking, from inside it) waiting
+        // for the loop to send them
+        std::mutex send_mut;
+        std::vector<queued_send> queued_sends;
+
+        // Merged sends totalling at most this much are copied into one contiguous buffer
+        static constexpr size_t CORK_COALESCE_MAX = 16_ki;
+        bool auto_cork{false};
+
+        // Cancellation state of incoming requests (see `message::cancelled`): callbacks registered by
+        // handlers, and the requests cancelled before being responded to.  The latter can also pick
+        // up cancellations that cross paths with our response, so it is capped at MAX_CANCELLED.
+        std::mutex cancel_mut;
+        std::unordered_map<int64_t, std::function<void()>> cancel_callbacks;
+        std::set<int64_t> cancelled_rids;
+        static constexpr size_t MAX_CANCELLED = 1024;
+        // Set once the stream closes, after which every incoming request counts as cancelled
+        bool all_cancelled{false};
+
+        bool cancel_on_timeout{false};
+        bool parse_in_place{false};
+
+        // `bt_chunk_writer::when_writable` callbacks, with their low water marks
+        std::vector<std::pair<size_t, std::function<void()>>> writable_waiters;
+
+        // Stream offsets at which each message we have sent ends, and the total we have sent, for
+        // `num_pending()`
+        std::deque<uint64_t> msg_ends;
+        uint64_t sent_total{0};
+
+        // Number of sends made into the stream by `send_now` (used by the test suite to check that
+        // messages are being merged)
+        uint64_t debug_send_count{0};
 
         bstring buf;
         std::string size_buf;
@@ -185,15 +505,31 @@ namespace oxen::quic
 
         std::atomic<int64_t> next_rid{0};
 
+        // Set when the stream belongs to a BTRequestChannel: request ids are drawn from the
+        // channel's shared counter instead of `next_rid`.
+        std::shared_ptr<std::atomic<int64_t>> shared_rids;
+
+        // Set for a BTRequestChannel's single-request streams: the stream closes itself once it no
+        // longer has any requests awaiting a response.
+        bool close_when_done{false};
+
+        int64_t take_rid() { return shared_rids ? (*shared_rids)++ : next_rid++; }
+
         friend struct sent_request;
         friend class Network;
         friend class Loop;
+        friend class BTRequestChannel;
+        friend class bt_chunk_writer;
+        friend class bt_batch;
+        friend class bt_request_handle;
+        friend struct message;
 
       protected:
         template <typename... Opt>
         explicit BTRequestStream(Connection& _c, Endpoint& _e, Opt&&... opts) : Stream{_c, _e}
         {
             ((void)handle_bp_opt(std::forward<Opt>(opts)), ...);
+            init_timeout_timer();
         }
 
       public:
@@ -214,29 +550,83 @@ namespace oxen::quic
                 Opt&&... opts:
                     std::function<void(message)> cb - callback to be executed if expecting response
                     std::chrono::milliseconds timeout - request timeout (defaults to 10 seconds)
+                    std::shared_ptr<void> keep_alive - keeps `body` alive until it has been sent, in
+                        which case the body is sent without being copied.  If omitted, the body is
+                        copied (once).
         */
         template <typename... Opt>
-        void command(std::string ep, bstring_view body, Opt&&... opts)
+        bt_request_handle command(std::string ep, bstring_view body, Opt&&... opts)
         {
-            auto rid = next_rid++;
-            auto req = std::make_shared<sent_request>(*this, encode_command(ep, rid, body), rid, std::forward<Opt>(opts)...);
+            auto rid = take_rid();
+            auto req = std::make_shared<sent_request>(
+                    *this, encode_command(ep, rid, body.size()), body, rid, std::forward<Opt>(opts)...);
 
             if (req->cb)
-                endpoint.call([this, r = std::move(req)]() mutable {
-                    if (auto* req = add_sent_request(std::move(r)))
-                        send(std::move(req->data));
-                });
+                send_command(std::move(req));
             else
-                send(std::move(*req).data);
+                send_request(std::move(*req));
+
+            return {weak_from_this(), rid};
         }
         // Same as above, but takes a regular string_view
         template <typename... Opt>
-        void command(std::string ep, std::string_view body, Opt&&... opts)
+        bt_request_handle command(std::string ep, std::string_view body, Opt&&... opts)
         {
-            command(std::move(ep), convert_sv<std::byte>(body), std::forward<Opt>(opts)...);
+            return command(std::move(ep), convert_sv<std::byte>(body), std::forward<Opt>(opts)...);
+        }
+
+        /** API: ::batch
+
+            Invokes `f` with a bt_batch to which it adds commands (via `b.command(...)`, which takes
+            the same arguments as `command`), then sends all of them at once: the commands are
+            encoded into a single contiguous buffer and handed to the stream with one send.
+
+                stream->batch([&](bt_batch& b) {
+                    for (auto& [ep, body] : requests)
+                        b.command(ep, body, response_cb);
+                });
+        */
+        template <std::invocable<bt_batch&> F>
+        void batch(F&& f)
+        {
+            bt_batch b{*this};
+            std::forward<F>(f)(b);
+            send_batch(std::move(b));
+        }
+
+        /// Enables or disables auto-corking.  When enabled, messages sent from within the event
+        /// loop (e.g. from request handlers and response callbacks) are held until the loop gets
+        /// back around to this stream's queue, so that everything sent within the same loop
+        /// iteration is merged into a single send.  Messages sent from outside the event loop are
+        /// always merged this way.
+        void set_auto_cork(bool enable);
+
+        /** API: ::command_stream
+
+            Invokes a remote RPC endpoint with a streamed body, which is sent (in chunks of up to
+            MAX_REQ_LEN) through the returned writer; see `message::is_chunk()` for how the remote
+            receives it.  Takes the same options as `command`; the timeout starts when the writer
+            finishes the body, and applies to the time until the first response chunk and then to
+            the time between response chunks.
+        */
+        template <typename... Opt>
+        bt_chunk_writer command_stream(std::string ep, Opt&&... opts)
+        {
+            auto rid = take_rid();
+            auto req = std::make_shared<sent_request>(*this, std::string{}, bstring_view{}, rid, std::forward<Opt>(opts)...);
+
+            if (req->cb)
+            {
+                req->expiry = sent_request::NO_EXPIRY;
+                endpoint.call([this, r = std::move(req)]() mutable { add_sent_request(std::move(r)); });
+            }
+
+            return {weak_from_this(), rid, std::move(ep)};
         }
 
-        void respond(int64_t rid, bstring_view body, bool error = false);
+        /// Sends a response to request `rid`.  If `keep_alive` is given it must keep `body` alive
+        /// until sent, and the body is sent without being copied; otherwise the body is copied.
+        void respond(int64_t rid, bstring_view body, bool error = false, std::shared_ptr<void> keep_alive = nullptr);
 
         /// Registers an individual endpoint to be recognized by this BTRequestStream object.  Can be
         /// called multiple times to set up multiple commands.  See also register_generic_handler.
@@ -249,16 +639,33 @@ namespace oxen::quic
         /// exception if the endpoint in this message should be considered not found.
         void register_generic_handler(std::function<void(message)> request_handler);
 
+        /// Sets (or replaces, or clears, if given nullptr) the shared, prebuilt router used to look
+        /// up endpoints not registered with `register_handler`.  Can also be given as a constructor
+        /// argument.
+        void set_router(std::shared_ptr<const bt_router> r);
+
+        /// Returns the number of requests and responses sent on this stream that have not yet been
+        /// fully acknowledged by the remote.
         size_t num_pending() const;
 
       protected:
-        void check_timeouts() override;
+        // Times out every request that expired before `now` (or every pending request, if `now` is
+        // nullopt), then re-arms the timeout timer.  Driven by the timeout timer rather than by the
+        // endpoint's periodic Stream::check_timeouts() scan.
         void check_timeouts(std::optional<std::chrono::steady_clock::time_point> now);
 
         void receive(bstring_view data) override;
 
+        // With opt::bt_parse_in_place we receive in retained mode, so that complete requests can be
+        // handed to handlers without copying them out of the stream's receive buffer.
+        bool retains_data() const override { return parse_in_place; }
+        void receive_slice(stream_slice data) override;
+
         void closed(uint64_t app_code) override;
 
+        // Invokes the `bt_chunk_writer::when_writable` callbacks whose low water mark has been reached
+        void on_acked() override;
+
       private:
         // Optional constructor argument: stream close callback
         void handle_bp_opt(std::function<void(Stream&, uint64_t)> close_cb);
@@ -267,18 +674,112 @@ namespace oxen::quic
         // is equivalent to calling register_command_fallback() with the lambda.
         void handle_bp_opt(std::function<void(message m)> request_handler);
 
+        // Optional constructor argument: shared endpoint router (see `set_router`)
+        void handle_bp_opt(std::shared_ptr<const bt_router> r);
+
+        // Optional constructor argument: worker pool on which to run request handlers (see
+        // bt_worker_pool).  Response callbacks still run on the event loop.
+        void handle_bp_opt(std::shared_ptr<bt_worker_pool> pool);
+
+        // Optional constructor argument: send cancellations for requests that time out
+        void handle_bp_opt(opt::bt_cancel_on_timeout);
+
+        // Optional constructor argument: parse requests in place in the receive buffer
+        void handle_bp_opt(opt::bt_parse_in_place);
+
         void handle_input(message msg);
 
-        void process_incoming(std::string_view req);
+        // Runs a request handler (or, if `handler` is nullptr, responds with an invalid endpoint
+        // error), turning exceptions into error responses.  `ep` is the endpoint name the handler
+        // was found under, which must outlive the call; it is empty for the generic handler (and
+        // when there is no handler), in which case the name is taken from `msg`.
+        void invoke_handler(const std::function<void(message)>* handler, std::string_view ep, message msg);
+
+        void flush_queued();
+
+        // Drops a request awaiting a response, and tells the remote it has been cancelled
+        void cancel(int64_t rid);
+        void send_cancel(int64_t rid);
+
+        // Handles an incoming cancellation of request `rid`
+        void handle_cancel(int64_t rid);
+
+        bool is_cancelled(int64_t rid);
+        void on_cancel(int64_t rid, std::function<void()> cb);
+        // Drops the cancellation state of `rid` once we have responded to it
+        void forget_cancel(int64_t rid);
+        void run_cancel_callback(int64_t rid, const std::function<void()>& cb);
+
+        // `slice`, if given, is the retained slice containing `req`; requests that lie entirely
+        // within it are parsed in place rather than copied.
+        void process_incoming(std::string_view req, const stream_slice* slice = nullptr);
+
+        // Encode the header of a request (everything that precedes the body on the wire; see
+        // `sent_request::header`) for a body of `body_size` bytes.
+        std::string encode_command(std::string_view endpoint, int64_t rid, size_t body_size);
+
+        std::string encode_response(int64_t rid, size_t body_size, bool error);
 
-        std::string encode_command(std::string_view endpoint, int64_t rid, bstring_view body);
+        // `ep` is set for command chunks, and unset for response chunks
+        std::string encode_chunk(const std::optional<std::string>& ep, int64_t rid, size_t body_size, bool fin);
 
-        std::string encode_response(int64_t rid, bstring_view body, bool error);
+        void send_chunk(
+                const std::optional<std::string>& ep,
+                int64_t rid,
+                bstring_view chunk,
+                bool fin,
+                std::shared_ptr<void> keep_alive);
+
+        // Sends a message that does not await a response
+        void send_request(sent_request&& req);
+
+        // Registers a request to await its response, then sends it
+        void send_command(std::shared_ptr<sent_request> req);
+
+        void send_batch(bt_batch&& b);
+
+        // Sends `q` right away when called in the event loop (unless auto-corking), and otherwise
+        // queues it for `flush_queued()`
+        void enqueue(queued_send q);
+
+        // Registers the requests of `q` and sends its data; must be called in the event loop
+        void send_now(queued_send q);
 
         sent_request* add_sent_request(std::shared_ptr<sent_request> req);
 
+        // Starts the timeout of streamed command `rid`, once its body has been finished
+        void start_timeout(int64_t rid);
+
+        void add_writable_waiter(size_t low_water, std::function<void()> cb);
+
+        void init_timeout_timer();
+
+        // (Re-)arms or clears the timeout timer for the earliest deadline
+        void schedule_timeout();
+
         size_t parse_length(std::string_view req);
 
-        size_t num_pending_impl() const { return user_buffers.size(); }
+        size_t num_pending_impl() const;
     };
+    template <typename... Opt>
+    bt_request_handle bt_batch::command(std::string_view ep, bstring_view body, Opt&&... opts)
+    {
+        auto rid = stream.take_rid();
+        auto hdr = stream.encode_command(ep, rid, body.size());
+        if (hdr.size() + body.size() + sent_request::TRAILER.size() > MAX_REQ_LEN)
+            throw std::invalid_argument{"Request body too long!"};
+
+        // The sent_request only tracks the callback and timeout; the request itself goes in `buf`
+        auto req = std::make_shared<sent_request>(stream, std::string{}, bstring_view{}, rid, std::forward<Opt>(opts)...);
+
+        *buf += convert_sv<std::byte>(std::string_view{hdr});
+        *buf += body;
+        *buf += sent_request::TRAILER;
+        count++;
+
+        if (req->cb)
+            requests.push_back(std::move(req));
+
+        return {stream.weak_from_this(), rid};
+    }
 }  // namespace oxen::quic
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace oxen::quic
+{
+    namespace detail
+    {
+        // Serial job queue of a single BTRequestStream within a bt_worker_pool
+        struct bt_strand
+        {
+            std::deque<std::function<void()>> jobs;
+            // True while the strand is waiting in the ready queue or one of its jobs is running
+            bool active{false};
+        };
+
+        struct bt_worker_state;
+    }  // namespace detail
+
+    /** bt_worker_pool:
+            Pool of worker threads on which BTRequestStreams constructed with it (see the
+        BTRequestStream constructor options) run their request handlers, so that slow handlers do
+        not stall the network I/O of the event loop.  Requests arriving on the same stream are
+        handled one at a time, in the order they arrived; requests on different streams are handled
+        in parallel.
+
+        Handlers run this way may call `message::respond` whenever they like: responses sent from
+        outside the event loop are queued and sent in batches by a single event loop job.  Response
+        callbacks of outgoing requests still run on the event loop.
+
+        Destroying the pool lets the workers finish the jobs already queued; the application should
+        keep the pool alive for as long as the Network whose streams use it.
+     */
+    class bt_worker_pool
+    {
+      public:
+        /// Starts `threads` workers.  Throws std::invalid_argument if `threads` is 0.
+        explicit bt_worker_pool(size_t threads = std::max(1u, std::thread::hardware_concurrency()));
+
+        bt_worker_pool(const bt_worker_pool&) = delete;
+        bt_worker_pool& operator=(const bt_worker_pool&) = delete;
+
+        ~bt_worker_pool();
+
+        size_t size() const { return threads.size(); }
+
+        std::shared_ptr<detail::bt_strand> make_strand() const { return std::make_shared<detail::bt_strand>(); }
+
+        /// Queues `job` to run on a worker after every job previously posted to the same strand.
+        void post(const std::shared_ptr<detail::bt_strand>& strand, std::function<void()> job);
+
+      private:
+        std::shared_ptr<detail::bt_worker_state> state;
+        std::vector<std::thread> threads;
+    };
+}  // namespace oxen::quic
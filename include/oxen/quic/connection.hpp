@@ -9,7 +9,9 @@
 #include <map>
 #include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
+#include <vector>
 
 #include "connection_ids.hpp"
 #include "context.hpp"
@@ -144,6 +146,58 @@ namespace oxen::quic
 
         virtual void send_datagram(bstring_view data, std::shared_ptr<void> keep_alive = nullptr) = 0;
 
+        /// Sends a datagram as above, then invokes `sent_cb` (from the event loop) with the transport it went out on:
+        /// dgram_transport::datagram, dgram_transport::stream if it was carried over the fallback stream (see
+        /// opt::datagram_fallback), or dgram_transport::dropped if it could not be sent at all.
+        virtual void send_datagram(bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb) = 0;
+
+        template <oxenc::basic_char CharType>
+            requires(!std::same_as<CharType, std::byte>)
+        void send_flow_datagram(
+                uint16_t flow_id, std::basic_string_view<CharType> data, std::shared_ptr<void> keep_alive = nullptr)
+        {
+            send_flow_datagram(flow_id, convert_sv<std::byte>(data), std::move(keep_alive));
+        }
+
+        template <oxenc::basic_char CharType>
+        void send_flow_datagram(uint16_t flow_id, std::basic_string<CharType>&& data)
+        {
+            auto keep_alive = std::make_shared<std::basic_string<CharType>>(std::move(data));
+            std::basic_string_view<CharType> view{*keep_alive};
+            send_flow_datagram(flow_id, view, std::move(keep_alive));
+        }
+
+        /// Sends a datagram on the given datagram flow (see opt::datagram_flows), which need not be
+        /// registered on this side of the connection; if it is, the datagram is queued subject to
+        /// that flow's queue limits and priority.  Flow 0 is the default flow, i.e. the same as
+        /// `send_datagram`.  Throws if flows are not enabled or the flow ID is out of range.
+        virtual void send_flow_datagram(
+                uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive = nullptr) = 0;
+
+        /// Sends a datagram on a flow as above, then reports its transport as with the `send_datagram` overload taking
+        /// a dgram_sent_callback.
+        virtual void send_flow_datagram(
+                uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb) = 0;
+
+        /// Queues a batch of datagrams, in order, with a single hop into the event loop and a single
+        /// flush afterwards.  `keep_alive`, if given, is held until every datagram in the batch has
+        /// been sent (or dropped).  Each datagram is subject to the same size limit as with
+        /// `send_datagram`; oversized datagrams are dropped (with a warning) without affecting the
+        /// rest of the batch.
+        virtual void send_datagrams(std::span<const bstring_view> data, std::shared_ptr<void> keep_alive = nullptr) = 0;
+
+        // Owning version of the above: takes ownership of the given datagrams until they are sent.
+        template <oxenc::basic_char Char>
+        void send_datagrams(std::vector<std::basic_string<Char>>&& data)
+        {
+            auto keep_alive = std::make_shared<std::vector<std::basic_string<Char>>>(std::move(data));
+            std::vector<bstring_view> views;
+            views.reserve(keep_alive->size());
+            for (const auto& d : *keep_alive)
+                views.push_back(convert_sv<std::byte>(std::basic_string_view<Char>{d}));
+            send_datagrams(std::span<const bstring_view>{views}, std::move(keep_alive));
+        }
+
         virtual Endpoint& endpoint() = 0;
         virtual const Endpoint& endpoint() const = 0;
 
@@ -212,6 +266,32 @@ namespace oxen::quic
         /// then you can safely never worry about this function.
         virtual std::optional<size_t> max_datagram_size_changed() = 0;
 
+        /// Returns the current size of this connection's datagram send queue along with the number
+        /// of datagrams discarded so far because of the endpoint's opt::datagram_queue limits.
+        datagram_queue_stats get_datagram_queue_stats();
+
+        /// Returns the current size of this connection's split datagram reassembly window (see
+        /// opt::adaptive_datagram_buffer) along with counts of reassembled datagrams, unmatched
+        /// halves discarded from the window, and the deepest reordering of halves seen so far.
+        datagram_reassembly_stats get_datagram_reassembly_stats();
+
+        /// Registers a datagram flow (see opt::datagram_flows) on this connection.  Datagrams
+        /// received on the flow are passed to `recv_cb` instead of the endpoint's datagram
+        /// callbacks; the data view is only valid for the duration of the callback.  Datagrams sent
+        /// on the flow are queued in a send queue of its own, bounded by `limits` (defaulting to the
+        /// endpoint's opt::datagram_queue limits), and sent ahead of the datagrams of any flows of
+        /// lower `priority`.  The default flow (0) has priority 0, and is sent ahead of other flows of
+        /// the same priority.  Priorities are strict: a busy high priority flow can starve lower
+        /// ones.
+        ///
+        /// Throws if flows are not enabled, if the flow ID is 0 or out of range, or if the flow is
+        /// already registered.  Flow queue sizes are included in get_datagram_queue_stats().
+        void register_datagram_flow(
+                uint16_t flow_id,
+                dgram_view_callback recv_cb,
+                int priority = 0,
+                std::optional<opt::datagram_queue> limits = std::nullopt);
+
         // WIP functions: these are meant to expose specific aspects of the internal state of connection
         // and the datagram IO object for debugging and application (user) utilization.
         //
@@ -235,6 +315,13 @@ namespace oxen::quic
         virtual const Address& remote_impl() const { return path_impl().remote; }
         // Returns 0 if datagrams are not available
         virtual size_t get_max_datagram_size_impl() = 0;
+        virtual datagram_queue_stats get_datagram_queue_stats_impl() const = 0;
+        virtual datagram_reassembly_stats get_datagram_reassembly_stats_impl() const = 0;
+        virtual void register_datagram_flow_impl(
+                uint16_t flow_id,
+                dgram_view_callback recv_cb,
+                int priority,
+                std::optional<opt::datagram_queue> limits) = 0;
     };
 
     class Connection : public connection_interface
@@ -297,6 +384,9 @@ namespace oxen::quic
         void set_draining() { draining = true; }
         stream_data_callback get_default_data_callback() const;
 
+        // Pool of receive blocks for streams of this connection using retained receive mode
+        detail::recv_block_pool& recv_pool();
+
         bool is_outbound() const override { return _is_outbound; }
         bool is_inbound() const override { return not is_outbound(); }
         std::string direction_str() override { return is_inbound() ? "SERVER"s : "CLIENT"s; }
@@ -312,6 +402,23 @@ namespace oxen::quic
 
         uint64_t get_streams_available_impl() const override;
         size_t get_max_datagram_size_impl() override;
+
+        // Datagram stream fallback (see opt::datagram_fallback)
+        bool datagram_fallback_enabled() const { return _dgram_fallback; }
+        // False if the remote's transport parameters say it doesn't accept datagrams (true until we have them)
+        bool remote_datagrams_supported() const;
+        // Writes a length-prefixed datagram, made up of `prefix` (e.g. a flow ID) followed by `data`, to the outgoing
+        // fallback stream, opening it first if needed.  Returns false if the stream cannot be opened (i.e. the remote
+        // doesn't allow it).
+        bool send_datagram_via_stream(bstring_view data, bstring_view prefix = {});
+
+        datagram_queue_stats get_datagram_queue_stats_impl() const override;
+        datagram_reassembly_stats get_datagram_reassembly_stats_impl() const override;
+        void register_datagram_flow_impl(
+                uint16_t flow_id,
+                dgram_view_callback recv_cb,
+                int priority,
+                std::optional<opt::datagram_queue> limits) override;
         uint64_t get_max_streams_impl() const override { return _max_streams; }
 
         bool datagrams_enabled() const override { return _datagrams_enabled; }
@@ -324,6 +431,15 @@ namespace oxen::quic
 
         void send_datagram(bstring_view data, std::shared_ptr<void> keep_alive = nullptr) override;
 
+        void send_datagram(bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb) override;
+
+        void send_flow_datagram(uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive = nullptr) override;
+
+        void send_flow_datagram(
+                uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb) override;
+
+        void send_datagrams(std::span<const bstring_view> data, std::shared_ptr<void> keep_alive = nullptr) override;
+
         void close_connection(uint64_t error_code = 0) override;
 
         // This mutator is called from the gnutls code after cert verification (if it is successful)
@@ -399,6 +515,7 @@ namespace oxen::quic
         const uint64_t _max_streams{DEFAULT_MAX_BIDI_STREAMS};
         const bool _datagrams_enabled{false};
         const bool _packet_splitting{false};
+        const bool _dgram_fallback{false};
         size_t _last_max_dgram_size{0};
         std::atomic<bool> _max_dgram_size_changed{true};
 
@@ -462,6 +579,14 @@ namespace oxen::quic
         std::shared_ptr<DatagramIO> datagrams;
         // "pseudo-stream" to represent ngtcp2 stream ID -1
         std::shared_ptr<Stream> pseudo_stream;
+
+        // Our unidirectional stream carrying datagrams that can't be sent as datagrams (see opt::datagram_fallback),
+        // opened on first use.  The remote's equivalent stream is handled by a stream made by make_datagram_receiver.
+        std::shared_ptr<Stream> _dgram_stream;
+
+        std::shared_ptr<Stream> make_datagram_receiver();
+        std::shared_ptr<detail::recv_block_pool> _recv_pool;
+
         // holds queue of pending streams not yet ready to broadcast
         // streams are added to the back and popped from the front (FIFO)
         std::deque<std::shared_ptr<Stream>> pending_streams;
@@ -476,6 +601,11 @@ namespace oxen::quic
 
         std::shared_ptr<dgram_interface> di;
 
+        // Datagram acks/losses accumulated since the last invocation of the delivery callback
+        uint64_t _dgram_acked{0}, _dgram_lost{0};
+
+        void report_datagram_delivery();
+
         /********* TEST SUITE FUNCTIONALITY *********/
         void set_local_addr(Address new_local);
         bool debug_datagram_drop_enabled{false};
@@ -494,7 +624,10 @@ namespace oxen::quic
         void close_all_streams();
         void check_pending_streams(uint64_t available);
         int recv_datagram(bstring_view data, bool fin);
+        // Hands a received (and, if needed, reassembled) datagram to the application's callback
+        int deliver_datagram(bstring_view data);
         int ack_datagram(uint64_t dgram_id);
+        int lost_datagram(uint64_t dgram_id);
         int recv_token(const uint8_t* token, size_t tokenlen);
 
         // Implicit conversion of Connection to the underlying ngtcp2_conn* (so that you can pass a
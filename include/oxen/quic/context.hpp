@@ -43,6 +43,8 @@ namespace oxen::quic
         stream_close_callback stream_close_cb;
         stream_constructor_callback stream_construct_cb;
         dgram_data_callback dgram_data_cb;
+        dgram_view_callback dgram_view_cb;
+        dgram_delivery_callback dgram_delivery_cb;
         connection_established_callback conn_established_cb;
         connection_closed_callback conn_closed_cb;
         user_config config{};
@@ -71,6 +73,9 @@ namespace oxen::quic
         void handle_ioctx_opt(stream_constructor_callback func);
         // Overrides the datagram callback specified at the endpoint level, if given.
         void handle_ioctx_opt(dgram_data_callback func);
+        void handle_ioctx_opt(opt::dgram_views dv);
+        // Overrides the datagram delivery callback specified at the endpoint level, if given.
+        void handle_ioctx_opt(dgram_delivery_callback func);
         void handle_ioctx_opt(connection_established_callback func);
         void handle_ioctx_opt(connection_closed_callback func);
 
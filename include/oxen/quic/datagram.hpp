@@ -53,6 +53,34 @@ namespace oxen::quic
     // IO callbacks
     using dgram_data_callback = std::function<void(dgram_interface&, bstring)>;
 
+    // Non-owning version of the above: the data is a view into the packet receive buffer (or, for split datagrams, the
+    // reassembly buffer) and is only valid for the duration of the callback.  Avoids allocating and copying each
+    // datagram for applications that don't need to hold on to it.  Given to an endpoint or connection wrapped in an
+    // opt::dgram_views; if both are given, only this one is invoked.
+    using dgram_view_callback = std::function<void(dgram_interface&, bstring_view)>;
+
+    // Datagram delivery feedback: reports the number of datagrams acknowledged and declared lost by the remote since
+    // the previous invocation.  It is invoked (from the event loop) at most once per round of packet processing, and
+    // only when at least one of the counts is non-zero.  Counts are of transmitted QUIC datagrams, so each half of a
+    // split datagram is counted separately.  When no such callback is given, delivery tracking is not enabled at all.
+    using dgram_delivery_callback = std::function<void(dgram_interface&, uint64_t acked, uint64_t lost)>;
+
+    // How a datagram passed to a reporting send (see connection_interface::send_datagram) went out: as a QUIC datagram,
+    // over the fallback stream (see opt::datagram_fallback), or not at all (e.g. because it was too large, or was
+    // discarded by a full send queue).
+    enum class dgram_transport { datagram, stream, dropped };
+
+    // Invoked (from the event loop) with the transport used for a datagram once it has been queued
+    using dgram_sent_callback = std::function<void(dgram_transport)>;
+
+    // A registered datagram flow of a connection (see opt::datagram_flows)
+    struct datagram_flow
+    {
+        dgram_view_callback recv_cb;
+        buffer_que queue;
+        int priority{0};
+    };
+
     using dgram_buffer = std::deque<std::pair<uint16_t, std::pair<bstring_view, std::shared_ptr<void>>>>;
 
     class DatagramIO : public IOChannel
@@ -62,10 +90,13 @@ namespace oxen::quic
         // Construct via net.make_shared<DatagramIO>(...)
         friend class Network;
         friend class Loop;
-        DatagramIO(Connection& c, Endpoint& e, dgram_data_callback data_cb = nullptr);
+        DatagramIO(
+                Connection& c, Endpoint& e, dgram_data_callback data_cb = nullptr, dgram_view_callback view_cb = nullptr);
 
       public:
         dgram_data_callback dgram_data_cb;
+        dgram_view_callback dgram_view_cb;
+        dgram_delivery_callback dgram_delivery_cb;
 
         /// Datagram Numbering:
         /// Each datagram ID is comprised of a 16 bit quantity consisting of a 14 bit counter, and
@@ -78,6 +109,10 @@ namespace oxen::quic
         ///                            ^^
         ///               split/nosplit|first or second packet
         ///
+        /// The otherwise unused `zz` value of 0b01 marks a fragment of a datagram sent in more than
+        /// two pieces (see opt::datagram_fragments); such datagrams carry one more header byte after
+        /// the ID holding the fragment index (upper 4 bits) and fragment count minus one (lower 4).
+        ///
         /// Example - unsplit packets:
         ///     Packet Number   |   Packet ID
         ///         1           |       4           In the unsplit packet scheme, the dgram ID of each
@@ -137,18 +172,79 @@ namespace oxen::quic
         ///         2               0         2
         ///         3               1         3
         ///
+        /// (These use the default bufsize of 4096; with opt::adaptive_datagram_buffer the bufsize, and
+        /// so the row size, changes as the connection goes.)
         rotating_buffer recv_buffer;
         // dgram_buffer send_buffer;
         buffer_que send_buffer;
 
+        // Maximum number of fragments per datagram (see opt::datagram_fragments); 2 (i.e. the
+        // halves of packet splitting) if fragmentation is not enabled, 1 if packet splitting isn't
+        // either.
+        const uint8_t max_fragments;
+
+        // Reassembly of incoming fragmented datagrams; only present if fragmentation is enabled
+        std::optional<fragment_reassembler> fragments;
+
+        // Datagram flows (see opt::datagram_flows): a flat table, indexed by flow ID, of the flows
+        // registered on this connection (nullptr for unregistered IDs), and the registered flows in
+        // the order their send queues are served (highest priority first).  Outgoing datagrams of
+        // the default flow (and of unregistered flows) go into `send_buffer`, which is served as a
+        // flow of priority 0 ahead of any other flows of priority 0.  Both are empty if flows are not
+        // enabled.
+        std::vector<std::unique_ptr<datagram_flow>> flows;
+        std::vector<datagram_flow*> flows_by_priority;
+
+        // Maximum size of the flow ID prefixed to each datagram when flows are enabled
+        static constexpr size_t FLOW_ID_OVERHEAD = 2;
+
+        bool flows_enabled() const { return !flows.empty(); }
+
+        void register_flow(uint16_t flow_id, dgram_view_callback recv_cb, int priority, opt::datagram_queue limits);
+
+        // Strips the flow ID from the front of a received datagram, returning it; returns nullopt
+        // (after logging) if the ID is invalid.
+        std::optional<uint16_t> read_flow_id(bstring_view& data) const;
+
+        // Forward error correction of outgoing and incoming datagrams; only present if FEC is enabled
+        // (see opt::enable_datagrams::fec).
+        std::optional<fec_encoder> fec_out;
+        std::optional<fec_decoder> fec_in;
+
         prepared_datagram pending_datagram(bool r) override;
 
         bool is_stream() const override { return false; }
 
-        std::optional<bstring> to_buffer(bstring_view data, uint16_t dgid);
+        std::optional<bstring_view> to_buffer(bstring_view data, uint16_t dgid);
+
+        // Hands off a fragment of a FRAGMENTED datagram (with the fragment header byte at the front
+        // of `data`) for reassembly.  Returns the complete datagram, if this was its last missing
+        // fragment, valid until the next call.
+        std::optional<bstring_view> to_fragments(bstring_view data, uint16_t dgid);
 
         int datagrams_stored() const { return recv_buffer.datagrams_stored(); }
 
+        // Queues each of `dgrams` as a separate datagram with a single event loop hop and flush
+        void send_batch(std::vector<bstring_view> dgrams, std::shared_ptr<void> keep_alive, uint16_t flow_id = 0);
+
+        // Queues a datagram on the given flow, then invokes `sent_cb`, if given
+        void send_flow(
+                uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb = nullptr);
+
+        // Queues a datagram on the default flow (in the event loop) and flushes, then invokes `sent_cb`, if given
+        void send_one(bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb)
+        {
+            send_one(0, data, std::move(keep_alive), std::move(sent_cb));
+        }
+
+        // Discards expired datagrams from all send queues
+        void expire(std::chrono::steady_clock::time_point now);
+
+        // Removes the piece of the datagram last returned by pending_datagram() from its send queue
+        void drop_front(bool r);
+
+        datagram_queue_stats queue_stats() const;
+
         int64_t stream_id() const override;
 
         std::shared_ptr<Stream> get_stream() override;
@@ -156,10 +252,44 @@ namespace oxen::quic
       private:
         const bool _packet_splitting{false};
 
+        // Assigns an ID to and queues a single datagram given the (already computed) current max size.  Returns the
+        // transport it was queued on, which is dgram_transport::dropped (after logging a warning) if the datagram is too
+        // large to send.  Must be called in the event loop.
+        dgram_transport queue_datagram(
+                bstring_view data, std::shared_ptr<void> keep_alive, size_t max_size, uint16_t flow_id = 0);
+
+        void send_one(uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb);
+
+        // Assigns an ID to and queues a single datagram as it is to be sent, i.e. after any FEC framing, with `prefix`
+        // (the flow ID, if flows are enabled and the datagram isn't FEC framed) going in front of `data`.  `max_size`
+        // here is the maximum size of such a datagram, including the prefix.
+        bool queue_wire_datagram(
+                bstring_view data,
+                std::shared_ptr<void> keep_alive,
+                size_t max_size,
+                buffer_que& queue,
+                bstring_view prefix = {});
+
+        // Queues the parity datagram of the FEC block just finished, if any.  `max_size` is as for queue_wire_datagram.
+        bool queue_parity(size_t max_size, buffer_que& queue);
+
+        // Returns the send queue to take the next datagram from, or nullptr if all are empty
+        buffer_que* next_queue();
+
+        // The queue that pending_datagram() last took a datagram from
+        buffer_que* _sending{nullptr};
+
+        // Number of datagrams sent over the fallback stream (see opt::datagram_fallback)
+        uint64_t _via_stream{0};
+
+        // Number of FEC parity datagrams queued
+        uint64_t _fec_parity{0};
+
       protected:
-        bool is_empty_impl() const override { return send_buffer.empty(); }
+        bool is_empty_impl() const override;
 
         void send_impl(bstring_view data, std::shared_ptr<void> keep_alive) override;
+        void send_impl(std::vector<bstring_view> bufs, std::shared_ptr<void> keep_alive) override;
 
         bool is_closing_impl() const override;
         bool sent_fin() const override;
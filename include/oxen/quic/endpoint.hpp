@@ -156,6 +156,18 @@ namespace oxen::quic
 
         int datagram_bufsize() const { return _rbufsize; }
 
+        uint8_t datagram_fec_block_size() const { return _fec_block_size; }
+
+        const opt::datagram_queue& datagram_queue_limits() const { return _dgram_queue; }
+
+        const std::optional<opt::datagram_fragments>& datagram_fragmentation() const { return _dgram_fragments; }
+
+        const std::optional<opt::datagram_flows>& datagram_flows() const { return _dgram_flows; }
+
+        bool datagram_fallback_enabled() const { return _dgram_fallback; }
+
+        const std::optional<opt::adaptive_datagram_buffer>& datagram_buffer_adaptation() const { return _adaptive_rbuf; }
+
         Splitting splitting_policy() const { return _policy; }
 
         void close_connection(Connection& conn, io_error ec = io_error{0}, std::optional<std::string> msg = std::nullopt);
@@ -204,6 +216,7 @@ namespace oxen::quic
         friend class Network;
         friend class Loop;
         friend class Connection;
+        friend class BTRequestStream;
         friend struct Callbacks;
         friend class TestHelper;
 
@@ -216,6 +229,12 @@ namespace oxen::quic
         bool _packet_splitting{false};
         Splitting _policy{Splitting::NONE};
         int _rbufsize{4096};
+        uint8_t _fec_block_size{0};
+        opt::datagram_queue _dgram_queue{};
+        std::optional<opt::datagram_fragments> _dgram_fragments;
+        std::optional<opt::datagram_flows> _dgram_flows;
+        bool _dgram_fallback{false};
+        std::optional<opt::adaptive_datagram_buffer> _adaptive_rbuf;
 
         opt::manual_routing _manual_routing;
 
@@ -242,11 +261,18 @@ namespace oxen::quic
         void _listen();
 
         void handle_ep_opt(opt::enable_datagrams dc);
+        void handle_ep_opt(opt::datagram_queue dq);
+        void handle_ep_opt(opt::datagram_fragments df);
+        void handle_ep_opt(opt::datagram_flows df);
+        void handle_ep_opt(opt::datagram_fallback df);
+        void handle_ep_opt(opt::adaptive_datagram_buffer ab);
         void handle_ep_opt(opt::outbound_alpns alpns);
         void handle_ep_opt(opt::inbound_alpns alpns);
         void handle_ep_opt(opt::alpns alpns);
         void handle_ep_opt(opt::handshake_timeout timeout);
         void handle_ep_opt(dgram_data_callback dgram_cb);
+        void handle_ep_opt(opt::dgram_views dv);
+        void handle_ep_opt(dgram_delivery_callback dgram_cb);
         void handle_ep_opt(connection_established_callback conn_established_cb);
         void handle_ep_opt(connection_closed_callback conn_closed_cb);
         void handle_ep_opt(opt::static_secret ssecret);
@@ -285,6 +311,8 @@ namespace oxen::quic
         void drop_connection(Connection& conn, io_error err);
 
         dgram_data_callback dgram_recv_cb;
+        dgram_view_callback dgram_view_recv_cb;
+        dgram_delivery_callback dgram_delivery_cb;
 
         void delete_connection(Connection& conn);
         void drain_connection(Connection& conn);
@@ -1,5 +1,7 @@
 #pragma once
 #include <concepts>
+#include <span>
+#include <vector>
 
 #include "connection_ids.hpp"
 #include "messages.hpp"
@@ -67,6 +69,26 @@ namespace oxen::quic
             send(std::basic_string_view<Char>{buf.data(), buf.size()}, std::make_shared<std::vector<Char>>(std::move(buf)));
         }
 
+        // Scatter-gather send: queues all of `bufs`, in order, as a single unit with one hop into the event loop, as if
+        // their contents had been concatenated (but without copying anything).  `keep_alive`, if given, is held until
+        // all of the buffers are no longer needed.  For datagrams the buffers are joined into a single datagram.
+        void send(std::span<const bstring_view> bufs, std::shared_ptr<void> keep_alive = nullptr)
+        {
+            send_impl(std::vector<bstring_view>{bufs.begin(), bufs.end()}, std::move(keep_alive));
+        }
+
+        // Owning version of the above: takes ownership of the given buffers for as long as they are needed.
+        template <oxenc::basic_char Char>
+        void send(std::vector<std::basic_string<Char>>&& bufs)
+        {
+            auto keep_alive = std::make_shared<std::vector<std::basic_string<Char>>>(std::move(bufs));
+            std::vector<bstring_view> views;
+            views.reserve(keep_alive->size());
+            for (const auto& b : *keep_alive)
+                views.push_back(convert_sv<std::byte>(std::basic_string_view<Char>{b}));
+            send_impl(std::move(views), std::move(keep_alive));
+        }
+
       protected:
         friend class Connection;
         friend struct rotating_buffer;
@@ -77,6 +99,9 @@ namespace oxen::quic
         // calls to send are converted into calls to this.
         virtual void send_impl(bstring_view, std::shared_ptr<void> keep_alive) = 0;
 
+        // Scatter-gather send implementation; `bufs` must be queued together, in order, all sharing `keep_alive`.
+        virtual void send_impl(std::vector<bstring_view> bufs, std::shared_ptr<void> keep_alive) = 0;
+
         virtual std::vector<ngtcp2_vec> pending() = 0;
         virtual prepared_datagram pending_datagram(bool) = 0;
         virtual bool sent_fin() const = 0;
@@ -15,6 +15,7 @@ extern "C"
 
 #include "context.hpp"
 #include "crypto.hpp"
+#include "slab.hpp"
 #include "utils.hpp"
 
 namespace oxen::quic
@@ -77,6 +78,10 @@ namespace oxen::quic
         std::optional<std::thread> loop_thread;
         std::thread::id loop_thread_id;
 
+        // Backing memory for objects created via make_shared; held by shared_ptr so that it outlives any objects that
+        // outlive the loop.
+        std::shared_ptr<slab_pool> _pool = std::make_shared<slab_pool>();
+
         event_ptr job_waker;
         std::queue<Job> job_queue;
         std::mutex job_queue_mutex;
@@ -140,14 +145,34 @@ namespace oxen::quic
 
         // Similar in concept to std::make_shared<T>, but it creates the shared pointer with a
         // custom deleter that dispatches actual object destruction to the network's event loop for
-        // thread safety.
+        // thread safety.  Both the object and the shared_ptr control block are allocated from the
+        // loop's slab pool, so that churned objects (such as streams) reuse memory rather than going
+        // through the global allocator each time.
         template <typename T, typename... Args>
         std::shared_ptr<T> make_shared(Args&&... args)
         {
-            auto* ptr = new T{std::forward<Args>(args)...};
-            return std::shared_ptr<T>{ptr, loop_deleter<T>()};
+            static_assert(alignof(T) <= slab_pool::ALIGN, "over-aligned types cannot be allocated from a slab_pool");
+
+            void* mem = _pool->allocate(sizeof(T));
+            T* ptr;
+            try
+            {
+                ptr = new (mem) T{std::forward<Args>(args)...};
+            }
+            catch (...)
+            {
+                _pool->deallocate(mem, sizeof(T));
+                throw;
+            }
+
+            return std::shared_ptr<T>{
+                    ptr,
+                    [this, del = slab_deleter<T>{_pool}](T* ptr) { call([ptr, del] { del(ptr); }); },
+                    slab_allocator<T>{_pool}};
         }
 
+        const std::shared_ptr<slab_pool>& pool() const { return _pool; }
+
         // Similar to the above make_shared, but instead of forwarding arguments for the
         // construction of the object, it creates the shared_ptr from the already created object ptr
         // and wraps the object's deleter in a wrapped_deleter
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <array>
+#include <utility>
 
 #include "address.hpp"
+#include "opt.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -10,7 +12,16 @@ namespace oxen::quic
 {
     class DatagramIO;
 
-    enum class dgram { STANDARD = 0, OVERSIZED = 1 };
+    // STANDARD datagrams are sent whole, OVERSIZED ones in two halves, and FRAGMENTED ones (see
+    // opt::datagram_fragments) as 3 or more fragments.
+    enum class dgram { STANDARD = 0, OVERSIZED = 1, FRAGMENTED = 2 };
+
+    // Fragment header byte of a FRAGMENTED datagram: fragment index in the upper 4 bits, fragment
+    // count minus one in the lower 4 bits.
+    inline constexpr uint8_t make_fragment_header(uint8_t index, uint8_t count)
+    {
+        return static_cast<uint8_t>(index << 4 | (count - 1));
+    }
 
     struct outbound_dgram
     {
@@ -24,10 +35,12 @@ namespace oxen::quic
 
     struct prepared_datagram
     {
-        uint64_t id;                  // internal ID for ngtcp2
-        std::array<uint8_t, 2> dgid;  // optional transmitted ID buffer (for packet splitting)
+        uint64_t id;  // internal ID for ngtcp2
+        // Header bytes sent in front of the data: the transmitted ID (+ fragment header) when packet splitting, then the
+        // flow ID (see opt::datagram_flows) of the first (or only) piece of a datagram when flows are enabled.
+        std::array<uint8_t, 5> dgid;
         std::array<ngtcp2_vec, 2> bufs;
-        size_t bufs_len;  // either 1 or 2 depending on how much of data is populated
+        size_t bufs_len;  // 1 or 2, depending on whether there are any header bytes
         // is the datagram_storage container empty after sending this payload?
         bool is_empty{false};
 
@@ -35,20 +48,24 @@ namespace oxen::quic
         size_t size() const { return bufs_len; }
     };
 
-    struct received_datagram
+    // Counters for a connection's datagram send queue (see opt::datagram_queue)
+    struct datagram_queue_stats
     {
-        uint16_t id{0};
-        // -1 = payload, 1 = addendum
-        int8_t part{0};
-        uint16_t data_size{0};
-        std::array<std::byte, MAX_PMTUD_UDP_PAYLOAD> data;
-
-        received_datagram() = default;
-        explicit received_datagram(uint16_t dgid, bstring_view d) :
-                id{dgid}, part{(dgid % 4 == 2) ? int8_t{-1} : int8_t{1}}, data_size{static_cast<uint16_t>(d.size())}
-        {
-            std::memcpy(data.data(), d.data(), data_size);
-        }
+        size_t queued{0};        // datagrams currently waiting to be sent
+        size_t queued_bytes{0};  // total size of the above
+        uint64_t dropped{0};     // datagrams discarded because a queue limit was reached
+        uint64_t expired{0};     // datagrams discarded because they were not sent before their deadline
+        uint64_t via_stream{0};  // datagrams sent over the fallback stream instead (see opt::datagram_fallback)
+        uint64_t fec_parity{0};  // FEC parity datagrams queued (see opt::enable_datagrams::fec)
+    };
+
+    struct datagram_reassembly_stats
+    {
+        int window{0};                  // current size (bufsize) of the split datagram reassembly window
+        uint64_t paired{0};             // split datagrams reassembled
+        uint64_t evicted{0};            // unmatched halves discarded (their counterpart never arrived in time)
+        uint16_t max_reorder_depth{0};  // furthest (in datagram IDs) a half has arrived behind the newest one
+        uint64_t resized{0};            // number of times an adaptive window has been resized
     };
 
     struct datagram_storage
@@ -58,15 +75,43 @@ namespace oxen::quic
         std::optional<bstring_view> payload, addendum;
         std::shared_ptr<void> keep_alive;
         dgram type;
+        // total size of the datagram (i.e. of both halves, if split)
+        size_t total_size{0};
+        // For FRAGMENTED datagrams: `payload` holds the not-yet-sent fragments, each of `frag_size` (except possibly the
+        // last one), of which `frag_next` is the next to go out.
+        uint16_t frag_size{0};
+        uint8_t frag_count{0}, frag_next{0};
+        // the datagram is discarded if still unsent at this time
+        std::chrono::steady_clock::time_point expiry{std::chrono::steady_clock::time_point::max()};
+        // Flow ID sent in front of the first piece of the datagram (from the header bytes of its prepared_datagram, so
+        // that the payload doesn't have to be copied to prefix it).  `prefix_len` is 0 when flows are not enabled.
+        std::array<uint8_t, 2> prefix{};
+        uint8_t prefix_len{0};
 
+        // For OVERSIZED datagrams, `max_size` is the maximum (two-piece) datagram size; for FRAGMENTED datagrams it is
+        // the size of each fragment.  Both include the `prefix` (at most 2 bytes), which goes in front of `pload`.
         static datagram_storage make(
-                bstring_view pload, uint16_t d_id, std::shared_ptr<void> data, dgram type, size_t max_size = 0);
+                bstring_view pload,
+                uint16_t d_id,
+                std::shared_ptr<void> data,
+                dgram type,
+                size_t max_size = 0,
+                bstring_view prefix = {});
 
         bool empty() const { return !(payload || addendum); }
 
+        // True if this is a split or fragmented datagram of which some part has already been sent
+        bool in_progress() const
+        {
+            return (type == dgram::OVERSIZED && !(payload && addendum)) || (type == dgram::FRAGMENTED && frag_next > 0);
+        }
+
         outbound_dgram fetch(bool b);
 
-        size_t size() const { return payload->length() + addendum->length(); }
+        // Payload bytes carried by the next fragment of a FRAGMENTED datagram (the first fragment also carries the prefix)
+        size_t frag_payload_size() const { return frag_next == 0 ? frag_size - prefix_len : frag_size; }
+
+        size_t size() const { return (payload ? payload->length() : 0) + (addendum ? addendum->length() : 0); }
 
       private:
         explicit datagram_storage(bstring_view pload, uint16_t p_id, std::shared_ptr<void> data) :
@@ -88,33 +133,241 @@ namespace oxen::quic
     {
         int row{0}, col{0}, last_cleared{-1};
         DatagramIO& datagram;
-        const int bufsize;
-        const int rowsize;
+        // Current window size and row size; these only change if the window is adaptive
+        int bufsize;
+        int rowsize;
         // tracks the number of partial datagrams held in each buffer bucket
         std::array<int, 4> currently_held{0, 0, 0, 0};
 
         explicit rotating_buffer() = delete;
         explicit rotating_buffer(DatagramIO& _d);
 
-        std::array<std::vector<std::unique_ptr<received_datagram>>, 4> buf;
-
-        std::optional<bstring> receive(bstring_view data, uint16_t dgid);
+        // Returns a view of the reassembled datagram when `data` completes a split pair.  The view points into the
+        // buffer's own storage and is only valid until the next call to `receive`.
+        std::optional<bstring_view> receive(bstring_view data, uint16_t dgid);
         void clear_row(int index);
         int datagrams_stored() const;
+
+        datagram_reassembly_stats stats() const
+        {
+            return {bufsize, paired, evicted, max_depth, resized};
+        }
+
+      private:
+        // Number of halves received between considering shrinking an adaptive window
+        static constexpr uint32_t ADAPT_EPOCH = 1024;
+
+        // Each slot holds one half of a split datagram, which can be at most this large
+        static constexpr size_t SLOT_SIZE = MAX_PMTUD_UDP_PAYLOAD;
+
+        struct slot_info
+        {
+            uint16_t size{0};
+            // datagram counter (ID without the split bits), to tell apart a stale half that happens to map to the same slot
+            uint16_t idx{0};
+            // -1 = payload, 1 = addendum
+            int8_t part{0};
+        };
+
+        const std::optional<opt::adaptive_datagram_buffer> adaptive;
+
+        // newest datagram counter seen so far (-1 before the first)
+        int high_idx{-1};
+        uint64_t paired{0}, evicted{0}, resized{0};
+        uint16_t max_depth{0};
+        // deepest reordering seen, and halves received, since an adaptive window was last resized or considered for
+        // shrinking
+        uint16_t epoch_depth{0};
+        uint32_t epoch_count{0};
+
+        // Updates the reorder statistics for a half with counter `idx`, resizing an adaptive window if warranted
+        void observe(uint16_t idx);
+
+        // Moves to a window of `new_bufsize`, relocating any halves currently held
+        void resize(int new_bufsize);
+
+        // Contiguous storage for all `bufsize` slots (row-major), followed by room for a reassembled pair.  Allocated
+        // on first use and left uninitialized, so pages for slots that never get used are never touched.
+        std::unique_ptr<std::byte[]> slab;
+        std::vector<slot_info> slots;
+        // occupancy bitmap for each row
+        std::array<std::vector<uint64_t>, 4> occupied;
+
+        size_t slot_index(int r, int c) const { return static_cast<size_t>(r) * rowsize + c; }
+        std::byte* slot_data(int r, int c) { return slab.get() + slot_index(r, c) * SLOT_SIZE; }
+        std::byte* reassembly_buffer() { return slab.get() + static_cast<size_t>(bufsize) * SLOT_SIZE; }
+
+        bool is_held(int r, int c) const { return occupied[r][c / 64] & (uint64_t{1} << (c % 64)); }
+        void set_held(int r, int c) { occupied[r][c / 64] |= uint64_t{1} << (c % 64); }
+        void unset_held(int r, int c) { occupied[r][c / 64] &= ~(uint64_t{1} << (c % 64)); }
+    };
+
+    // Reassembles datagrams received as 3 or more fragments (see opt::datagram_fragments).  Each
+    // datagram being reassembled gets a fixed-size buffer (reused once the datagram completes, times
+    // out, or is evicted) so that memory use is bounded by the configured number of partial
+    // datagrams.
+    struct fragment_reassembler
+    {
+        explicit fragment_reassembler(const opt::datagram_fragments& config) : config{config} {}
+
+        // Adds a fragment, returning the reassembled datagram if this completes it.  The returned
+        // view points into the reassembler's own storage and is only valid until the next call.
+        std::optional<bstring_view> receive(
+                bstring_view data, uint16_t dgid, uint8_t header, std::chrono::steady_clock::time_point now);
+
+        size_t num_partial() const { return partial.size(); }
+        uint64_t num_expired() const { return expired; }
+        uint64_t num_evicted() const { return evicted; }
+
+      private:
+        // Each fragment is at most this large
+        static constexpr size_t SLOT_SIZE = MAX_PMTUD_UDP_PAYLOAD;
+
+        struct partial_dgram
+        {
+            uint16_t id;
+            uint8_t count;
+            uint16_t have{0};  // bitmap of received fragments
+            std::array<uint16_t, opt::datagram_fragments::MAX_FRAGMENTS> sizes{};
+            std::chrono::steady_clock::time_point started;
+            std::unique_ptr<std::byte[]> buf;  // one SLOT_SIZE slot per fragment
+        };
+
+        const opt::datagram_fragments config;
+        std::vector<partial_dgram> partial;
+        std::vector<std::unique_ptr<std::byte[]>> free_bufs;
+        // buffer of the most recently completed datagram, which the last returned view points into
+        std::unique_ptr<std::byte[]> completed;
+        uint64_t expired{0}, evicted{0};
+
+        std::unique_ptr<std::byte[]> get_buffer();
+        std::vector<partial_dgram>::iterator release(std::vector<partial_dgram>::iterator it);
+    };
+
+    // XOR forward error correction of outgoing datagrams (see opt::enable_datagrams::fec).  Every
+    // datagram is prefixed with a 4-byte FEC header:
+    //
+    //     [block (2 bytes, big-endian)][index (1 byte)][count (1 byte)]
+    //
+    // where `count` is 0 for a data datagram, and is the number of data datagrams in the block for
+    // the block's parity datagram.  The body of a parity datagram is the XOR of the lengths of the
+    // block's datagrams (2 bytes, big-endian) followed by the XOR of their contents (each padded
+    // with zeros to the length of the longest).  The FEC header goes in front of the datagram
+    // *before* any packet splitting or fragmentation, so a datagram that gets split is protected (and
+    // recovered) as a whole.
+    struct fec_encoder
+    {
+        static constexpr size_t HEADER_SIZE = 4;
+        // Space to reserve in each datagram so that the block's parity datagram (which is 2 bytes
+        // longer than the longest datagram of the block) always fits.
+        static constexpr size_t OVERHEAD = HEADER_SIZE + 2;
+
+        explicit fec_encoder(uint8_t block_size) : block_size{block_size} {}
+
+        // Returns `prefix` (e.g. a flow ID) and `data` with an FEC header prepended, adding them into
+        // the parity of the current block.  When this fills up the block, its parity datagram becomes
+        // available from `take_parity()`.
+        bstring encode(bstring_view data, bstring_view prefix = {});
+
+        std::optional<bstring> take_parity() { return std::exchange(parity, std::nullopt); }
+
+        // Ends the current block early if it is at least half full, making its parity datagram
+        // available from `take_parity()`.  Used when the send queue drains, so that the last
+        // datagrams of a burst don't go unprotected while waiting for their block to fill up,
+        // without a low-rate sender (whose queue drains after every datagram) paying for a parity
+        // datagram per datagram.
+        void flush();
+
+      private:
+        void finish_block();
+
+        const uint8_t block_size;
+        uint16_t block{0};
+        uint8_t index{0};
+        uint16_t len_xor{0};
+        bstring acc;
+        std::optional<bstring> parity;
+    };
+
+    // Receiving side of fec_encoder: strips the FEC header from received datagrams, and rebuilds the
+    // single missing datagram of a block once the rest of the block and its parity have arrived.
+    // Only the most recent WINDOW blocks are tracked; datagrams of older blocks are still delivered,
+    // but can no longer help to recover anything.
+    struct fec_decoder
+    {
+        static constexpr size_t WINDOW = 8;
+
+        // Returns the payload of a data datagram (a view into `data`), or nullopt for a parity
+        // datagram, a duplicate of a datagram that was already recovered, or an invalid datagram.
+        // Either kind of datagram can complete a recovery; check `take_recovered()` afterwards.
+        std::optional<bstring_view> receive(bstring_view data);
+
+        // Returns the datagram rebuilt by the last call to `receive`, if any.  The view points into
+        // the decoder's own storage and is only valid until the next call to `receive`.
+        std::optional<bstring_view> take_recovered() { return std::exchange(recovered, std::nullopt); }
+
+        uint64_t num_recovered() const { return total_recovered; }
+
+      private:
+        struct block_state
+        {
+            uint16_t id{0};
+            bool active{false};
+            uint8_t count{0};  // number of data datagrams in the block, once the parity has arrived
+            bool have_parity{false};
+            bool done{false};
+            uint8_t received{0};
+            uint64_t have{0};  // bitmap of received (or recovered) data datagram indices
+            uint16_t len_xor{0};
+            bstring acc;
+        };
+
+        std::array<block_state, WINDOW> blocks{};
+        std::optional<bstring_view> recovered;
+        uint64_t total_recovered{0};
+
+        // Returns the state for block `id`, or nullptr if it is too old to still be tracked
+        block_state* get_block(uint16_t id);
+
+        static void add(bstring& acc, bstring_view data);
+
+        void try_recover(block_state& b);
     };
 
     struct buffer_que
     {
         std::deque<datagram_storage> buf{};
+        opt::datagram_queue limits{};
 
         bool empty() const { return buf.empty(); }
         size_t size() const { return buf.size(); }
+        size_t bytes() const { return _bytes; }
 
         void drop_front(bool b);
 
         prepared_datagram prepare(bool b, int is_splitting);
 
-        void emplace(bstring_view pload, uint16_t p_id, std::shared_ptr<void> data, dgram type, size_t max_size = 0);
+        // Returns false if the datagram was discarded instead of being queued (because of the queue limits).  See
+        // datagram_storage::make for the meaning of `max_size` and `prefix`.
+        bool emplace(
+                bstring_view pload,
+                uint16_t p_id,
+                std::shared_ptr<void> data,
+                dgram type,
+                size_t max_size = 0,
+                bstring_view prefix = {});
+
+        // Discards all datagrams whose deadline has passed
+        void expire(std::chrono::steady_clock::time_point now);
+
+        datagram_queue_stats stats() const { return {buf.size(), _bytes, _dropped, _expired, 0}; }
+
+      private:
+        size_t _bytes{0};
+        uint64_t _dropped{0}, _expired{0};
+
+        bool over_limit(size_t extra_bytes) const;
+        void pop(std::deque<datagram_storage>::iterator it);
     };
 
 }  // namespace oxen::quic
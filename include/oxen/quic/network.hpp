@@ -64,6 +64,10 @@ namespace oxen::quic
             return _loop->make_shared<T>(std::forward<Args>(args)...);
         }
 
+        // Returns statistics for the slab pool backing the objects (endpoints, connections, streams) of this network's
+        // event loop.
+        slab_pool::stats_t pool_stats() const { return _loop->pool()->stats(); }
+
         void set_shutdown_immediate(bool b = true) { shutdown_immediate = b; }
 
         template <typename Callable>
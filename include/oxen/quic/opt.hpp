@@ -10,6 +10,7 @@ namespace oxen::quic
 {
     class Endpoint;
     class Stream;
+    struct dgram_interface;
 
     namespace opt
     {
@@ -100,18 +101,51 @@ namespace oxen::quic
         /// NGTCP2_MAX_PMTUD_UDP_PAYLOAD_SIZE (1452), or near it, per datagram. Please note that enabling
         /// datagram splitting will double whatever value is returned.
         ///
+        /// Forward error correction can optionally be enabled by passing an `enable_datagrams::fec`
+        /// as the last constructor argument.  Outgoing datagrams are then grouped into blocks of
+        /// (up to) `block_size` datagrams, each followed by an extra parity datagram (the XOR of the
+        /// block) from which the receiver can rebuild any single datagram of the block that was lost.
+        /// A block that is at least half full is cut short, and its parity sent, whenever the datagram
+        /// send queue drains, so that the tail of a burst is protected as well; the datagrams of a
+        /// less than half full block wait for later datagrams to complete it.  (The number of parity
+        /// datagrams sent is in `connection_interface::get_datagram_queue_stats()`.)  This costs at
+        /// most one extra datagram per `block_size / 2` datagrams, a copy
+        /// of each outgoing datagram, and 6 bytes of the maximum datagram size; recovered datagrams
+        /// are handed to the datagram callback as soon as they are rebuilt (and so may arrive out of
+        /// order).  Both sides must enable it, but the block size only matters to the sender (each
+        /// parity datagram says how many datagrams its block has), so they need not agree on it.
+        ///
         /// Note: this setting CANNOT be changed for an endpoint after creation, it must be
         /// destroyed and re-initialized with the desired settings.
         struct enable_datagrams
         {
+            struct fec
+            {
+                static constexpr uint8_t MAX_BLOCK_SIZE = 64;
+
+                uint8_t block_size;
+
+                explicit fec(uint8_t block_size) : block_size{block_size}
+                {
+                    if (block_size < 2)
+                        throw std::out_of_range{"FEC block size must be at least 2"};
+                    if (block_size > MAX_BLOCK_SIZE)
+                        throw std::out_of_range{"FEC block size too large"};
+                }
+            };
+
             bool split_packets{false};
             Splitting mode{Splitting::NONE};
             // Note: this is the size of the entire buffer, divided amongst 4 rows
             int bufsize{4096};
+            // Number of datagrams per FEC block; 0 if FEC is disabled
+            uint8_t fec_block_size{0};
 
             enable_datagrams() = default;
             explicit enable_datagrams(bool e) = delete;
+            explicit enable_datagrams(fec f) : fec_block_size{f.block_size} {}
             explicit enable_datagrams(Splitting m) : split_packets{true}, mode{m} {}
+            explicit enable_datagrams(Splitting m, fec f) : split_packets{true}, mode{m}, fec_block_size{f.block_size} {}
             explicit enable_datagrams(Splitting m, int b) : split_packets{true}, mode{m}, bufsize{b}
             {
                 if (b <= 0)
@@ -121,6 +155,152 @@ namespace oxen::quic
                 if (b % 4 != 0)
                     throw std::invalid_argument{"Bufsize must be evenly divisible between 4 rows"};
             }
+            explicit enable_datagrams(Splitting m, int b, fec f) : enable_datagrams{m, b}
+            {
+                fec_block_size = f.block_size;
+            }
+        };
+
+        /// Extends datagram packet splitting (which otherwise splits a datagram into at most two
+        /// halves) to allow datagrams of up to `max_fragments` fragments, e.g. to carry 9000-byte
+        /// jumbo frames over a standard MTU path.  Datagrams that fit into one or two pieces are still
+        /// sent exactly as without this option; larger ones are sent as fragments carrying an extra
+        /// byte of header with the fragment index and count.  Both sides of a connection must enable
+        /// this to use fragmented datagrams.  Has no effect unless packet splitting is enabled (see
+        /// `enable_datagrams`).
+        ///
+        /// When enabled, `connection_interface::get_max_datagram_size()` returns the fragmented
+        /// maximum.  The receiving side reassembles at most `max_partial` datagrams at once (evicting
+        /// the oldest incomplete one to make room for a new one), and discards incomplete datagrams
+        /// that are not completed within `reassembly_timeout` of their first fragment arriving.
+        /// Memory for reassembly is bounded by `max_partial` datagrams of the maximum size.
+        struct datagram_fragments
+        {
+            static constexpr uint8_t MAX_FRAGMENTS = 16;
+
+            uint8_t max_fragments{MAX_FRAGMENTS};
+            std::chrono::milliseconds reassembly_timeout{1s};
+            size_t max_partial{16};
+
+            datagram_fragments() = default;
+            explicit datagram_fragments(
+                    uint8_t max_fragments, std::chrono::milliseconds reassembly_timeout = 1s, size_t max_partial = 16) :
+                    max_fragments{max_fragments}, reassembly_timeout{reassembly_timeout}, max_partial{max_partial}
+            {
+                if (max_fragments < 3 || max_fragments > MAX_FRAGMENTS)
+                    throw std::out_of_range{"Datagram fragment count must be between 3 and 16"};
+                if (reassembly_timeout <= 0ms)
+                    throw std::invalid_argument{"Datagram reassembly timeout must be positive"};
+                if (max_partial == 0)
+                    throw std::invalid_argument{"Datagram partial reassembly limit must be positive"};
+            }
+        };
+
+        /// Makes the split datagram reassembly window (the `bufsize` of `enable_datagrams`) of each
+        /// connection adaptive: it starts out at `min_bufsize` and grows (doubling, up to
+        /// `max_bufsize`) when a half of a split datagram arrives further behind the newest one than
+        /// the current window can safely hold, and shrinks again (halving) when the reorder distance
+        /// observed over a while stays well under the window.  Both limits must be powers of 2 between
+        /// 16 and 16384.  The `bufsize` given to `enable_datagrams` is ignored when this is used.
+        ///
+        /// The current window size and reassembly statistics are available via
+        /// connection_interface::get_datagram_reassembly_stats().  Has no effect unless packet
+        /// splitting is enabled.
+        struct adaptive_datagram_buffer
+        {
+            int min_bufsize{64};
+            int max_bufsize{1 << 14};
+
+            adaptive_datagram_buffer() = default;
+            explicit adaptive_datagram_buffer(int min_bufsize, int max_bufsize = 1 << 14) :
+                    min_bufsize{min_bufsize}, max_bufsize{max_bufsize}
+            {
+                auto valid = [](int b) { return b >= 16 && b <= 1 << 14 && (b & (b - 1)) == 0; };
+                if (!valid(min_bufsize) || !valid(max_bufsize))
+                    throw std::out_of_range{"Adaptive datagram bufsize limits must be powers of 2 from 16 to 16384"};
+                if (min_bufsize > max_bufsize)
+                    throw std::invalid_argument{"Adaptive datagram bufsize minimum cannot exceed the maximum"};
+            }
+        };
+
+        /// Enables carrying datagrams over a stream when they can't go out as QUIC datagrams: when
+        /// the remote does not support datagrams (or local datagram support isn't enabled at all), or
+        /// when a datagram is larger than `connection_interface::get_max_datagram_size()` (up to a
+        /// maximum of 65535 bytes).  Such datagrams are written, with a 2-byte length prefix, to a
+        /// dedicated unidirectional stream that is only given a chance to send after the
+        /// connection's regular streams and datagrams.  Sending stays asynchronous, but datagrams
+        /// sent this way are delivered reliably and in order (and so potentially later than they
+        /// would have been as datagrams).
+        ///
+        /// The remote end must enable this too, for both sending and receiving: without it, it
+        /// does not allow the stream to be opened, and datagrams that would have used the stream are
+        /// dropped as before.  The number of datagrams sent over the stream is available in
+        /// `connection_interface::get_datagram_queue_stats()`, and the transport used for an
+        /// individual datagram is reported to the dgram_sent_callback of `send_datagram` (or
+        /// `send_flow_datagram`), if one is given.
+        struct datagram_fallback
+        {};
+
+        /// Bounds the datagram send queue of each connection of an endpoint.  Without this, datagrams
+        /// queued faster than the connection can send them (e.g. because the path is congested)
+        /// accumulate without limit and end up being delivered arbitrarily late.
+        ///
+        /// When queuing a new datagram would exceed `max_count` or `max_bytes`, either the oldest
+        /// queued datagrams are discarded to make room (drop::OLDEST, the default) or the new
+        /// datagram is discarded (drop::NEWEST).  Datagrams that have gone unsent for `max_age` after
+        /// being queued are discarded when the connection next tries to send.  (A split datagram
+        /// whose first half has already gone out is never discarded.)  Zero values mean no limit.
+        ///
+        /// Counts of discarded datagrams are available via
+        /// connection_interface::get_datagram_queue_stats().
+        struct datagram_queue
+        {
+            enum class drop { OLDEST, NEWEST };
+
+            size_t max_count{0};
+            size_t max_bytes{0};
+            std::chrono::milliseconds max_age{0ms};
+            drop policy{drop::OLDEST};
+
+            datagram_queue() = default;
+            explicit datagram_queue(
+                    size_t max_count,
+                    size_t max_bytes = 0,
+                    std::chrono::milliseconds max_age = 0ms,
+                    drop policy = drop::OLDEST) :
+                    max_count{max_count}, max_bytes{max_bytes}, max_age{max_age}, policy{policy}
+            {
+                if (max_age < 0ms)
+                    throw std::invalid_argument{"Datagram max age cannot be negative"};
+            }
+        };
+
+        /// Enables datagram flow multiplexing, in the spirit of RFC 9297 context IDs: each datagram
+        /// is prefixed with a flow ID (encoded as a 1- or 2-byte QUIC variable-length integer) that the
+        /// receiving side uses to dispatch it to that flow's callback.  Flow IDs must be less than
+        /// `max_flows`, which sizes the flat flow table of each connection (and can be at most
+        /// MAX_FLOWS, the largest value that fits in a 2-byte varint).  Both sides of a connection
+        /// must enable this.
+        ///
+        /// Flow 0 is the default flow: datagrams sent with `send_datagram` go out on it, and are
+        /// delivered to the endpoint's regular datagram callbacks.  Other flows are set up on a
+        /// connection with connection_interface::register_datagram_flow, and sent to with
+        /// connection_interface::send_flow_datagram.  Received datagrams for a flow that has not
+        /// been registered are dropped.
+        ///
+        /// When enabled, `connection_interface::get_max_datagram_size()` is reduced by 2 bytes.
+        struct datagram_flows
+        {
+            static constexpr uint16_t MAX_FLOWS = 1 << 14;
+
+            uint16_t max_flows{64};
+
+            datagram_flows() = default;
+            explicit datagram_flows(uint16_t max_flows) : max_flows{max_flows}
+            {
+                if (max_flows < 2 || max_flows > MAX_FLOWS)
+                    throw std::out_of_range{"Datagram flow count must be between 2 and 16384"};
+            }
         };
 
         // Used to provide precalculated static secret data for an endpoint to use for validation
@@ -142,6 +322,18 @@ namespace oxen::quic
             }
         };
 
+        /// Receives incoming datagrams through a callback taking a view of each datagram (see
+        /// dgram_view_callback) rather than an owned copy.  Can be given to an endpoint, or to a
+        /// connection, in place of a dgram_data_callback; if both are given, only this one is invoked.
+        /// (The callback is wrapped, rather than given directly, so that a bare lambda passed as an
+        /// option still unambiguously means a dgram_data_callback.)
+        struct dgram_views
+        {
+            std::function<void(dgram_interface&, bstring_view)> callback;
+
+            explicit dgram_views(std::function<void(dgram_interface&, bstring_view)> cb) : callback{std::move(cb)} {}
+        };
+
         // Used to provide a callback that bypasses sending packets out through the UDP socket. The passing of
         // this opt will also bypass the creation of the UDP socket entirely. The application will also need to
         // take responsibility for passing packets into the Endpoint via Endpoint::manually_receive_packet(...)
@@ -202,5 +394,21 @@ namespace oxen::quic
                     _hook = nullptr;
             }
         };
+
+        // BTRequestStream constructor option: also sends the remote a cancellation (as with
+        // `bt_request_handle::cancel()`) for each of our requests that times out, so that it can
+        // stop working on it.  Only use this when the remote is known to understand cancellations:
+        // older versions treat them as requests for an empty endpoint.
+        struct bt_cancel_on_timeout
+        {};
+
+        // BTRequestStream constructor option: receive in retained mode, so that requests arriving
+        // whole within a chunk of stream data are parsed in place instead of being copied out of the
+        // stream's receive buffer.  Each message then pins the receive buffer (and the flow control
+        // credit) of the data it references until it is destroyed, so this suits handlers that are
+        // done with their message when they return, rather than ones that hold on to messages (e.g.
+        // to respond later, or on a worker pool).
+        struct bt_parse_in_place
+        {};
     }  //  namespace opt
 }  // namespace oxen::quic
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace oxen::quic
+{
+    /** slab_pool:
+            Thread-safe fixed-size-chunk allocator used for the long-lived, frequently churned objects of a Loop (streams,
+        connections, and the shared_ptr control blocks that own them).  Requests are rounded up to a multiple of
+        `ALIGN` and served from per-size free lists; when a free list is empty a new chunk is carved out of the current
+        slab for that size (or a new slab is allocated).  Freed chunks go back on their free list for reuse by the next
+        object of the same size class: slab memory itself is only released when the pool is destroyed.
+
+        The pool is held via shared_ptr by the objects allocated from it so that it outlives all of them, regardless of
+        the destruction order of the Loop and whatever holds on to its objects.
+     */
+    class slab_pool
+    {
+      public:
+        static constexpr size_t SLAB_SIZE = 64_ki;
+        static constexpr size_t ALIGN = alignof(std::max_align_t);
+
+        struct stats_t
+        {
+            size_t slabs{0};       // number of slabs allocated
+            size_t reserved{0};    // total bytes of slab memory allocated
+            size_t in_use{0};      // number of chunks currently allocated
+            size_t allocs{0};      // total number of allocation requests
+            size_t reused{0};      // number of allocation requests served from a free list
+        };
+
+        slab_pool() = default;
+        slab_pool(const slab_pool&) = delete;
+        slab_pool& operator=(const slab_pool&) = delete;
+
+        void* allocate(size_t size);
+
+        void deallocate(void* p, size_t size) noexcept;
+
+        stats_t stats() const;
+
+      private:
+        struct size_class
+        {
+            std::vector<void*> free;
+            std::byte* next{nullptr};
+            size_t remaining{0};  // chunks left to carve out of the current slab at `next`
+            size_t total{0};      // total chunks carved out for this size
+        };
+
+        static constexpr size_t round_up(size_t size) { return (std::max<size_t>(size, 1) + ALIGN - 1) / ALIGN * ALIGN; }
+
+        mutable std::mutex mut;
+        std::unordered_map<size_t, size_class> classes;
+        std::vector<std::unique_ptr<std::max_align_t[]>> slabs;
+        stats_t _stats;
+    };
+
+    // Standard allocator that draws from a slab_pool; used to put shared_ptr control blocks into the same pool as the
+    // objects they manage.
+    template <typename T>
+    struct slab_allocator
+    {
+        using value_type = T;
+
+        std::shared_ptr<slab_pool> pool;
+
+        explicit slab_allocator(std::shared_ptr<slab_pool> p) : pool{std::move(p)} {}
+
+        template <typename U>
+        slab_allocator(const slab_allocator<U>& other) : pool{other.pool}
+        {}
+
+        T* allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+
+        void deallocate(T* p, size_t n) noexcept { pool->deallocate(p, n * sizeof(T)); }
+
+        template <typename U>
+        bool operator==(const slab_allocator<U>& other) const
+        {
+            return pool == other.pool;
+        }
+    };
+
+    // Destroys and returns the memory of an object that was constructed in place in memory obtained from a slab_pool.
+    template <typename T>
+    struct slab_deleter
+    {
+        std::shared_ptr<slab_pool> pool;
+
+        void operator()(T* ptr) const
+        {
+            ptr->~T();
+            pool->deallocate(ptr, sizeof(T));
+        }
+    };
+
+}  // namespace oxen::quic
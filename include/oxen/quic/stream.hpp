@@ -7,6 +7,7 @@
 #include <functional>
 #include <memory>
 #include <queue>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -14,6 +15,7 @@
 #include "error.hpp"
 #include "iochannel.hpp"
 #include "opt.hpp"
+#include "stream_slice.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -33,6 +35,12 @@ namespace oxen::quic
     using stream_open_callback = std::function<uint64_t(Stream&)>;
     using stream_unblocked_callback = std::function<bool(Stream&)>;
 
+    // Pull-mode stream data providers (see Stream::set_data_provider).  A view provider returns up to `budget` bytes of
+    // data plus a keep-alive that holds the data until acknowledged; a buffer provider writes up to `buf.size()` bytes into
+    // a library-supplied buffer and returns the number of bytes written.
+    using stream_view_provider = std::function<std::pair<bstring_view, std::shared_ptr<void>>(Stream&, size_t budget)>;
+    using stream_buffer_provider = std::function<size_t(Stream&, std::span<std::byte> buf)>;
+
     void _chunk_sender_trace(const char* file, int lineno, std::string_view message);
     void _chunk_sender_trace(const char* file, int lineno, std::string_view message, size_t val);
 
@@ -42,6 +50,7 @@ namespace oxen::quic
         friend class Connection;
         friend class Network;
         friend class Loop;
+        friend class stream_slice;
 
       protected:
         Stream(Connection& conn,
@@ -91,6 +100,52 @@ namespace oxen::quic
 
         bool is_paused() const;
 
+        /** Stream Data Providers:
+            - Rather than pushing data into the stream ahead of time (via `::send(...)` or `::send_chunks(...)`),
+                applications can call `::set_data_provider(...)` to have the stream *pull* data only when the connection is
+                actually able to send it, i.e. when stream and connection flow control and the congestion window allow it
+            - The provider is invoked from inside the event loop while packets are being written, and is given a byte
+                budget of what can currently be sent. It must not produce more than that amount: a provider that does
+                is treated as having raised an exception, closing the stream
+            - A buffer provider may be given less than the full budget; the buffers it writes into are reused once the
+                data written into them has been acknowledged
+            - Returning an empty view (or writing 0 bytes) signals the end of the data: the provider is cleared and `done`
+                is invoked on a subsequent event loop iteration, at which point it is safe to close the stream or queue up
+                more data
+            - Data produced by the provider is held only until it is acknowledged, so memory usage is bounded by the flow
+                control window rather than the size of the payload
+            - Providers must not call `::send(...)` (or otherwise queue data on this stream) from within the provider
+            - Invoking this function while a provider is already set replaces it (without calling the previous `done`)
+        */
+        void set_data_provider(stream_view_provider provider, std::function<void(Stream&)> done = nullptr);
+        void set_data_provider(stream_buffer_provider provider, std::function<void(Stream&)> done = nullptr);
+
+        // Clears any currently set data provider on this stream object, without calling its `done` callback
+        void clear_data_provider();
+
+        bool has_data_provider() const;
+
+#ifndef _WIN32
+        // Default size of the file regions mapped at once by send_file()
+        static constexpr size_t DEFAULT_FILE_WINDOW = 8_Mi;
+
+        /// Sends `len` bytes of the file referred to by `fd` starting at file position `offset` without copying it into
+        /// userspace buffers: the file is memory-mapped in windows of (up to) `window` bytes which are handed directly
+        /// to the stream (with the mapping as keep-alive), and each window is unmapped once all of its data has been
+        /// acknowledged.  Windows are mapped lazily (via a stream data provider, see `::set_data_provider(...)`), and
+        /// only as the connection is able to send, so at most a couple of windows are mapped at any given time.
+        ///
+        /// `fd` is duplicated, so the caller is free to close its own descriptor after this call returns.  Throws if the
+        /// file cannot be stat'ed or if the requested range extends beyond the end of the file.  `done` is invoked once
+        /// the entire range has been queued (as with `::send_chunks(...)`, *not* once it has been acknowledged).
+        void send_file(
+                int fd,
+                size_t offset,
+                size_t len,
+                std::function<void(Stream&)> done = nullptr,
+                size_t window = DEFAULT_FILE_WINDOW);
+#endif
+
         // These public methods are synchronized so that they can be safely called from outside the
         // libquic main loop thread.
         bool available() const;
@@ -103,8 +158,20 @@ namespace oxen::quic
         void set_stream_data_cb(stream_data_callback cb) { data_callback = std::move(cb); }
         void set_stream_close_cb(stream_close_callback cb) { close_callback = std::move(cb); }
 
+        /** Retained Receive Mode:
+            - Setting a slice callback switches the stream into retained receive mode: incoming data is copied (once)
+                into pooled receive blocks and delivered as refcounted `stream_slice`s rather than as a `bstring_view`
+                that is only valid for the duration of the callback
+            - Slices may be kept, sub-sliced, and passed between threads without copying the data again
+            - Flow control credit for received data is only handed back to the remote once every slice referencing that
+                data has been destroyed, so holding on to slices will (eventually) throttle the sender
+            - When set, the slice callback replaces the regular data callback
+        */
+        void set_stream_slice_cb(stream_slice_callback cb) { slice_callback = std::move(cb); }
+
         stream_data_callback data_callback;
         stream_close_callback close_callback;
+        stream_slice_callback slice_callback;
 
       protected:
         virtual void receive(bstring_view data)
@@ -113,33 +180,53 @@ namespace oxen::quic
                 data_callback(*this, data);
         }
 
+        // Called instead of receive() when the stream is in retained receive mode (see `retains_data()`)
+        virtual void receive_slice(stream_slice data)
+        {
+            if (slice_callback)
+                slice_callback(*this, std::move(data));
+        }
+
+        // Returns true if incoming data should be delivered via receive_slice() rather than receive().  The default
+        // returns true if a slice callback is set; subclasses that parse incoming data themselves can override it.
+        virtual bool retains_data() const { return static_cast<bool>(slice_callback); }
+
         virtual void closed(uint64_t app_code);
 
         // Called immediately after set_ready so that a subclass can do thing as soon as the stream
         // becomes ready. The default does nothing.
         virtual void on_ready() {}
 
+        // Called after acknowledged data has been dropped from the send buffers, so that a subclass can queue more
+        // data as earlier data is delivered.  The default does nothing.
+        virtual void on_acked() {}
+
         /// Called periodically to check if anything needs to be timed out.  The default does
         /// nothing, but subclasses can override to not do nothing if it's not the case that nothing
         /// ain't not good enough isn't false.
         virtual void check_timeouts() {}
 
         void send_impl(bstring_view data, std::shared_ptr<void> keep_alive = nullptr) override;
+        void send_impl(std::vector<bstring_view> bufs, std::shared_ptr<void> keep_alive = nullptr) override;
 
         stream_buffer user_buffers;
 
         bool sent_fin() const override { return _sent_fin; }
         void set_fin(bool v) override { _sent_fin = v; }
 
-        bool has_unsent_impl() const override { return not is_empty_impl(); }
+        bool has_unsent_impl() const override { return not is_empty_impl() or _provider; }
         bool is_closing_impl() const override { return _is_closing; }
         bool is_empty_impl() const override { return user_buffers.empty(); }
         size_t unsent_impl() const override;
 
+        // Total bytes held in user_buffers: sent but not yet acknowledged, plus not yet sent
+        size_t size() const { return _buffered_size; }
+
       private:
         std::vector<ngtcp2_vec> pending() override;
 
         size_t _unacked_size{0};
+        size_t _buffered_size{0};
         bool _is_closing{false};
         bool _is_shutdown{false};
         bool _sent_fin{false};
@@ -160,22 +247,30 @@ namespace oxen::quic
         opt::watermark _high_water;
         opt::watermark _low_water;
 
+        // Receive block currently being filled in retained receive mode
+        detail::recv_block* _recv_block{nullptr};
+
+        // Copies incoming data into the current receive block, returning a slice of it
+        stream_slice make_slice(bstring_view data, bool fin);
+
+        // Called (from any thread) when retained data has been released to hand its flow control credit back
+        void return_credit(size_t bytes);
+
+        void release_recv_block();
+
+        stream_view_provider _provider;
+        std::function<void(Stream&)> _provider_done;
+
+        // Invoked from pending() when all queued data has been written: asks the data provider (if any) for as much data
+        // as flow control and the congestion window currently allow.
+        void pull_from_provider();
+
         void wrote(size_t bytes) override;
 
         void append_buffer(bstring_view buffer, std::shared_ptr<void> keep_alive);
 
         void acknowledge(size_t bytes);
 
-        size_t size() const
-        {
-            size_t sum{0};
-            if (user_buffers.empty())
-                return sum;
-            for (const auto& [data, store] : user_buffers)
-                sum += data.size();
-            return sum;
-        }
-
         size_t unacked() const { return _unacked_size; }
 
         // Implementations classes for send_chunks()
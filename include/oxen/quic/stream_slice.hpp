@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace oxen::quic
+{
+    class Stream;
+
+    namespace detail
+    {
+        struct recv_block;
+        class recv_block_pool;
+
+        // Lives inside a recv_block, immediately before the received data it describes.  The data it covers is released
+        // (and its flow control credit returned to the stream) once the last stream_slice referencing it goes away.
+        struct slice_header
+        {
+            std::atomic<uint32_t> refs{1};
+            uint32_t credit;
+            recv_block* block;
+
+            slice_header(uint32_t credit, recv_block* block) : credit{credit}, block{block} {}
+        };
+
+        // A fixed-size block of received stream data belonging to a single stream.  Blocks are filled sequentially
+        // by the stream and handed back to the pool once the stream has moved on to a new block *and* every slice
+        // pointing into it has been released.
+        struct recv_block
+        {
+            std::atomic<uint32_t> refs{0};
+            size_t used{0};
+            const size_t capacity;
+            std::unique_ptr<std::byte[]> buf;
+
+            std::shared_ptr<recv_block_pool> pool;
+            std::weak_ptr<Stream> owner;
+
+            explicit recv_block(size_t capacity) : capacity{capacity}, buf{new std::byte[capacity]} {}
+
+            // Returns true if there is room to append `size` bytes of data (plus its slice header)
+            bool fits(size_t size) const;
+
+            // Appends a copy of `data` to the block, returning the header of the new slice (with a refcount of 1).
+            // `credit` is the amount of flow control credit to return once the slice is released.
+            slice_header* append(bstring_view data, size_t credit);
+        };
+
+        // Drops a reference to a block; when it hits zero the block is returned to its pool.
+        void release_block(recv_block* block);
+
+        // Pool of receive blocks shared by all the streams of a connection.  Blocks may be returned from any thread
+        // (since the application is allowed to hold on to slices wherever it likes).
+        class recv_block_pool : public std::enable_shared_from_this<recv_block_pool>
+        {
+          public:
+            static constexpr size_t BLOCK_SIZE = 64_ki;
+            // Maximum number of unused blocks to hang on to for reuse; beyond this, returned blocks are freed.
+            static constexpr size_t MAX_FREE = 64;
+
+            recv_block_pool() = default;
+            recv_block_pool(const recv_block_pool&) = delete;
+            recv_block_pool& operator=(const recv_block_pool&) = delete;
+            ~recv_block_pool();
+
+            // Returns a block with room for at least `min_size` bytes, holding a single reference that belongs to the
+            // caller.
+            recv_block* get(size_t min_size);
+
+            void put(recv_block* block);
+
+            size_t num_free() const;
+
+          private:
+            mutable std::mutex mut;
+            std::vector<recv_block*> free_blocks;
+        };
+    }  // namespace detail
+
+    /// A refcounted, read-only slice of received stream data (see `Stream::set_stream_slice_cb`).  Unlike the
+    /// `bstring_view` given to a regular stream data callback, a slice may be kept (and copied, moved, sub-sliced, or
+    /// passed to another thread) for as long as needed without copying the underlying data.  The stream's flow control
+    /// credit for the data is only handed back to the remote once every slice referencing it has been destroyed.
+    class stream_slice
+    {
+        friend class Stream;
+
+        detail::slice_header* hdr{nullptr};
+        const std::byte* _data{nullptr};
+        size_t _size{0};
+
+        stream_slice(detail::slice_header* h, const std::byte* data, size_t size) : hdr{h}, _data{data}, _size{size} {}
+
+        void release();
+
+      public:
+        stream_slice() = default;
+        stream_slice(const stream_slice& s);
+        stream_slice(stream_slice&& s) noexcept;
+        stream_slice& operator=(const stream_slice& s);
+        stream_slice& operator=(stream_slice&& s) noexcept;
+        ~stream_slice() { release(); }
+
+        const std::byte* data() const { return _data; }
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+
+        template <oxenc::basic_char Char = std::byte>
+        std::basic_string_view<Char> view() const
+        {
+            return {reinterpret_cast<const Char*>(_data), _size};
+        }
+
+        /// Returns a new slice referencing (and keeping alive) a subrange of this slice's data
+        stream_slice substr(size_t pos, size_t count = std::string_view::npos) const;
+    };
+
+    using stream_slice_callback = std::function<void(Stream&, stream_slice)>;
+
+}  // namespace oxen::quic
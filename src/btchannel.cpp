@@ -0,0 +1,54 @@
+#include "btchannel.hpp"
+
+#include <stdexcept>
+
+#include "internal.hpp"
+
+namespace oxen::quic
+{
+    inline auto bc_cat = oxen::log::Cat("bchannel");
+
+    BTRequestChannel::BTRequestChannel(
+            std::shared_ptr<connection_interface> c,
+            std::shared_ptr<const bt_router> r,
+            size_t pool_size,
+            size_t threshold) :
+            conn{std::move(c)}, router{std::move(r)}, dedicated_threshold{threshold}
+    {
+        if (pool_size == 0)
+            throw std::invalid_argument{"BTRequestChannel pool size must be at least 1"};
+
+        pool.reserve(pool_size);
+        for (size_t i = 0; i < pool_size; i++)
+        {
+            auto s = conn->open_stream<BTRequestStream>(router);
+            s->shared_rids = rids;
+            pool.push_back(std::move(s));
+        }
+
+        log::debug(bc_cat, "Opened BT request channel with {} pooled streams", pool_size);
+    }
+
+    BTRequestChannel::~BTRequestChannel()
+    {
+        for (auto& s : pool)
+            s->close();
+    }
+
+    std::shared_ptr<BTRequestStream> BTRequestChannel::open_dedicated()
+    {
+        log::trace(bc_cat, "Opening dedicated stream for BT request");
+
+        auto s = conn->open_stream<BTRequestStream>(router);
+        s->shared_rids = rids;
+        s->close_when_done = true;
+        return s;
+    }
+
+    stream_constructor_callback BTRequestChannel::stream_constructor(std::shared_ptr<const bt_router> router)
+    {
+        return [router = std::move(router)](Connection& c, Endpoint& e, std::optional<int64_t>) -> std::shared_ptr<Stream> {
+            return e.make_shared<BTRequestStream>(c, e, router);
+        };
+    }
+}  // namespace oxen::quic
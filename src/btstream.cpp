@@ -8,7 +8,7 @@ namespace oxen::quic
 {
     inline auto bp_cat = oxen::log::Cat("bparser");
 
-    static std::pair<std::ptrdiff_t, std::size_t> get_location(bstring& data, std::string_view substr)
+    static std::pair<std::ptrdiff_t, std::size_t> get_location(bstring_view data, std::string_view substr)
     {
         auto* bsubstr = reinterpret_cast<const std::byte*>(substr.data());
         // Make sure the given substr actually is a substr of data:
@@ -20,31 +20,174 @@ namespace oxen::quic
             data{std::move(req)}, return_sender{bp.weak_from_this()}, _rid{bp.reference_id}, timed_out{is_timeout}
     {
         if (!is_timeout)
-        {
-            oxenc::bt_list_consumer btlc(data);
+            parse();
+    }
+
+    message::message(BTRequestStream& bp, stream_slice req) :
+            slice{std::move(req)}, return_sender{bp.weak_from_this()}, _rid{bp.reference_id}
+    {
+        parse();
+    }
 
-            req_type = get_location(data, btlc.consume_string_view());
-            req_id = btlc.consume_integer<int64_t>();
+    void message::parse()
+    {
+        auto req = view<std::byte>();
+        oxenc::bt_list_consumer btlc(req);
 
-            if (type() == TYPE_COMMAND)
-                ep = get_location(data, btlc.consume_string_view());
+        req_type = get_location(req, btlc.consume_string_view());
+        req_id = btlc.consume_integer<int64_t>();
 
-            req_body = get_location(data, btlc.consume_string_view());
+        auto t = type();
+        if (t == TYPE_COMMAND || t == TYPE_COMMAND_CHUNK)
+            ep = get_location(req, btlc.consume_string_view());
 
-            btlc.finish();
+        if (t == TYPE_COMMAND_CHUNK || t == TYPE_REPLY_CHUNK)
+        {
+            _chunk = true;
+            _last = btlc.consume_integer<int>() != 0;
         }
+
+        req_body = get_location(req, btlc.consume_string_view());
+
+        btlc.finish();
     }
 
-    void message::respond(bstring_view body, bool error) const
+    void message::respond(bstring_view body, bool error, std::shared_ptr<void> keep_alive) const
     {
         log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
 
         if (auto ptr = return_sender.lock())
-            ptr->respond(req_id, body, error);
+            ptr->respond(req_id, body, error, std::move(keep_alive));
         else
             log::warning(bp_cat, "BTRequestStream unable to send response: stream has gone away");
     }
 
+    bt_router::bt_router(std::vector<std::pair<std::string, handler>> endpoints) : table{std::move(endpoints)}
+    {
+        std::sort(table.begin(), table.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            if (!table[i].second)
+                throw std::invalid_argument{"bt_router handler for endpoint '{}' is empty"_format(table[i].first)};
+            if (i > 0 && table[i - 1].first == table[i].first)
+                throw std::invalid_argument{"bt_router endpoint '{}' given more than once"_format(table[i].first)};
+        }
+    }
+
+    const bt_router::handler* bt_router::find(std::string_view ep) const
+    {
+        auto* entry = find_entry(ep);
+        return entry ? &entry->second : nullptr;
+    }
+
+    const std::pair<std::string, bt_router::handler>* bt_router::find_entry(std::string_view ep) const
+    {
+        auto itr = std::lower_bound(
+                table.begin(), table.end(), ep, [](const auto& e, std::string_view ep) { return e.first < ep; });
+
+        if (itr != table.end() && itr->first == ep)
+            return &*itr;
+        return nullptr;
+    }
+
+    bt_chunk_writer message::respond_stream() const
+    {
+        return {return_sender, req_id};
+    }
+
+    bool message::cancelled() const
+    {
+        if (auto ptr = return_sender.lock())
+            return ptr->is_cancelled(req_id);
+        return true;
+    }
+
+    void message::on_cancel(std::function<void()> cb) const
+    {
+        if (auto ptr = return_sender.lock())
+            ptr->on_cancel(req_id, std::move(cb));
+        else
+            cb();  // Nobody is going to receive the response, so the request is as good as cancelled
+    }
+
+    void bt_request_handle::cancel()
+    {
+        if (auto s = stream.lock())
+            s->cancel(rid);
+    }
+
+    bt_chunk_writer::bt_chunk_writer(bt_chunk_writer&& w) noexcept :
+            stream{std::move(w.stream)}, rid{w.rid}, ep{std::move(w.ep)}, _finished{w._finished}
+    {
+        w._finished = true;
+    }
+
+    bt_chunk_writer::~bt_chunk_writer()
+    {
+        if (_finished)
+            return;
+
+        try
+        {
+            finish();
+        }
+        catch (const std::exception& e)
+        {
+            log::warning(bp_cat, "Failed to finish streamed message {}: {}", rid, e.what());
+        }
+    }
+
+    void bt_chunk_writer::send(bstring_view chunk, std::shared_ptr<void> keep_alive, bool fin)
+    {
+        if (_finished)
+            throw std::logic_error{"Streamed message has already been finished"};
+
+        auto s = stream.lock();
+        if (!s)
+        {
+            _finished = true;
+            log::warning(bp_cat, "Unable to send streamed message chunk: stream has gone away");
+            return;
+        }
+
+        s->send_chunk(ep, rid, chunk, fin, std::move(keep_alive));
+        _finished = fin;
+    }
+
+    void bt_chunk_writer::write(bstring_view chunk, std::shared_ptr<void> keep_alive)
+    {
+        send(chunk, std::move(keep_alive), false);
+    }
+
+    void bt_chunk_writer::finish(bstring_view chunk, std::shared_ptr<void> keep_alive)
+    {
+        send(chunk, std::move(keep_alive), true);
+    }
+
+    void bt_chunk_writer::when_writable(std::function<void()> cb, size_t low_water)
+    {
+        if (_finished)
+            throw std::logic_error{"Streamed message has already been finished"};
+
+        if (auto s = stream.lock())
+            s->add_writable_waiter(low_water, std::move(cb));
+        else
+            log::warning(bp_cat, "Unable to wait for streamed message {}: stream has gone away", rid);
+    }
+
+    void bt_chunk_writer::fail(bstring_view body)
+    {
+        if (ep)
+            throw std::logic_error{"Streamed commands cannot be failed; finish them instead"};
+        if (_finished)
+            throw std::logic_error{"Streamed message has already been finished"};
+
+        _finished = true;
+        if (auto s = stream.lock())
+            s->respond(rid, body, true);
+    }
+
     void BTRequestStream::handle_bp_opt(std::function<void(Stream&, uint64_t)> close_cb)
     {
         log::debug(bp_cat, "Bparser set user-provided close callback!");
@@ -53,42 +196,253 @@ namespace oxen::quic
     void BTRequestStream::handle_bp_opt(std::function<void(message m)> request_handler)
     {
         log::debug(bp_cat, "Bparser set generic request handler");
-        generic_handler = std::move(request_handler);
+        if (request_handler)
+            generic_handler = std::make_shared<const std::function<void(message)>>(std::move(request_handler));
+    }
+    void BTRequestStream::handle_bp_opt(std::shared_ptr<const bt_router> r)
+    {
+        log::debug(bp_cat, "Bparser set shared endpoint router");
+        router = std::move(r);
     }
-    void BTRequestStream::respond(int64_t rid, bstring_view body, bool error)
+    void BTRequestStream::handle_bp_opt(std::shared_ptr<bt_worker_pool> pool)
+    {
+        log::debug(bp_cat, "Bparser set request handler worker pool");
+        strand = pool ? pool->make_strand() : nullptr;
+        workers = std::move(pool);
+    }
+    void BTRequestStream::handle_bp_opt(opt::bt_cancel_on_timeout)
+    {
+        log::debug(bp_cat, "Bparser set to cancel timed out requests");
+        cancel_on_timeout = true;
+    }
+    void BTRequestStream::handle_bp_opt(opt::bt_parse_in_place)
+    {
+        log::debug(bp_cat, "Bparser set to parse requests in place");
+        parse_in_place = true;
+    }
+    void BTRequestStream::respond(int64_t rid, bstring_view body, bool error, std::shared_ptr<void> keep_alive)
     {
         log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
 
-        send(sent_request{*this, encode_response(rid, body, error), rid}.data);
+        forget_cancel(rid);
+        send_request(sent_request{*this, encode_response(rid, body.size(), error), body, rid, std::move(keep_alive)});
     }
 
-    void BTRequestStream::check_timeouts()
+    void BTRequestStream::send_request(sent_request&& req)
     {
-        log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
-        return check_timeouts(get_time());
+        auto [bufs, keep_alive] = std::move(req).wire();
+        enqueue(queued_send{std::move(bufs), std::move(keep_alive), {}});
+    }
+
+    void BTRequestStream::send_command(std::shared_ptr<sent_request> req)
+    {
+        auto [bufs, keep_alive] = std::move(*req).wire();
+        queued_send q{std::move(bufs), std::move(keep_alive), {}};
+        q.requests.push_back(std::move(req));
+        enqueue(std::move(q));
+    }
+
+    void BTRequestStream::send_batch(bt_batch&& b)
+    {
+        if (b.empty())
+            return;
+
+        bstring_view data{*b.buf};
+        enqueue(queued_send{{data}, std::move(b.buf), std::move(b.requests), b.count});
+    }
+
+    void BTRequestStream::set_auto_cork(bool enable)
+    {
+        endpoint.call([this, enable] {
+            auto_cork = enable;
+            if (!auto_cork)
+                flush_queued();
+        });
+    }
+
+    void BTRequestStream::enqueue(queued_send q)
+    {
+        const bool in_loop = endpoint.in_event_loop();
+        if (in_loop && !auto_cork)
+            return send_now(std::move(q));
+
+        // Otherwise we queue the message: the first one queued schedules a job that sends
+        // everything queued by the time it runs, so that a burst of sends costs a single trip into
+        // the event loop (and a single append to the stream).
+        bool schedule;
+        {
+            std::lock_guard lock{send_mut};
+            schedule = queued_sends.empty();
+            queued_sends.push_back(std::move(q));
+        }
+        if (schedule)
+            endpoint.call_soon([self = weak_from_this()] {
+                if (auto s = self.lock())
+                    s->flush_queued();
+            });
+    }
+
+    void BTRequestStream::flush_queued()
+    {
+        std::vector<queued_send> queued;
+        {
+            std::lock_guard lock{send_mut};
+            queued.swap(queued_sends);
+        }
+        if (queued.empty())
+            return;
+        if (queued.size() == 1)
+            return send_now(std::move(queued.front()));
+
+        log::trace(bp_cat, "Sending {} queued messages", queued.size());
+
+        queued_send all;
+        all.messages = 0;
+        size_t total = 0;
+        for (auto& q : queued)
+        {
+            for (auto& b : q.bufs)
+                total += b.size();
+            all.messages += q.messages;
+            std::move(q.requests.begin(), q.requests.end(), std::back_inserter(all.requests));
+        }
+
+        if (total <= CORK_COALESCE_MAX)
+        {
+            // Small enough to be worth copying everything into a single contiguous buffer (and
+            // letting go of the individual messages' keep-alives right away)
+            auto buf = std::make_shared<bstring>();
+            buf->reserve(total);
+            for (auto& q : queued)
+                for (auto& b : q.bufs)
+                    *buf += b;
+            all.bufs.emplace_back(*buf);
+            all.keep_alive = std::move(buf);
+        }
+        else
+        {
+            auto keep_alive = std::make_shared<std::vector<std::shared_ptr<void>>>();
+            keep_alive->reserve(queued.size());
+            for (auto& q : queued)
+            {
+                all.bufs.insert(all.bufs.end(), q.bufs.begin(), q.bufs.end());
+                keep_alive->push_back(std::move(q.keep_alive));
+            }
+            all.keep_alive = std::move(keep_alive);
+        }
+
+        send_now(std::move(all));
+    }
+
+    void BTRequestStream::send_now(queued_send q)
+    {
+        assert(endpoint.in_event_loop());
+
+        for (auto& req : q.requests)
+            add_sent_request(std::move(req));
+
+        // If the stream is closing then add_sent_request has already timed out the requests, and
+        // there's no point in sending anything
+        if (is_closing())
+            return;
+
+        uint64_t bytes = 0;
+        for (auto& b : q.bufs)
+            bytes += b.size();
+
+        // Each message's end offset within `bytes` isn't tracked for a merged send: they're all
+        // counted as ending with it, which is what matters for num_pending().
+        sent_total += bytes;
+        msg_ends.insert(msg_ends.end(), q.messages, sent_total);
+
+        send_impl(std::move(q.bufs), std::move(q.keep_alive));
+        debug_send_count++;
+
+        // Forget about the messages that have been fully acknowledged
+        auto acked = sent_total - size();
+        while (!msg_ends.empty() && msg_ends.front() <= acked)
+            msg_ends.pop_front();
     }
 
     void BTRequestStream::check_timeouts(std::optional<std::chrono::steady_clock::time_point> now)
     {
         log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
 
-        while (!sent_reqs.empty())
+        // We re-check the front each time around because a timeout handler is allowed to issue new
+        // requests on this stream.
+        while (!deadlines.empty())
         {
-            auto& f = *sent_reqs.front();
-            if (now && !f.is_expired(*now))
-                return;
-            auto ptr = std::move(sent_reqs.front());
-            sent_reqs.pop_front();
+            auto [expiry, rid] = *deadlines.begin();
+            if (now && expiry >= *now)
+                break;
+            deadlines.erase(deadlines.begin());
+
+            auto itr = sent_reqs.find(rid);
+            assert(itr != sent_reqs.end());
+            auto ptr = std::move(itr->second);
+            sent_reqs.erase(itr);
+
+            // Let the remote know it can stop working on the request, if it is known to understand
+            // cancellations (and unless we're here because the stream is closing, in which case it'll
+            // find out anyway)
+            if (now && cancel_on_timeout)
+                send_cancel(rid);
 
             try
             {
-                f.cb(std::move(f).to_timeout());
+                ptr->cb(std::move(*ptr).to_timeout());
             }
             catch (const std::exception& e)
             {
                 log::error(bp_cat, "Uncaught exception from timeout response handler: {}", e.what());
             }
         }
+
+        schedule_timeout();
+
+        if (close_when_done && sent_reqs.empty() && !is_closing())
+            close();
+    }
+
+    void BTRequestStream::init_timeout_timer()
+    {
+        timeout_timer.reset(event_new(
+                endpoint.get_loop().get(),
+                -1,
+                0,
+                [](evutil_socket_t, short, void* self) {
+                    static_cast<BTRequestStream*>(self)->check_timeouts(get_time());
+                },
+                this));
+    }
+
+    void BTRequestStream::schedule_timeout()
+    {
+        if (!timeout_timer)
+            return;
+
+        // Streamed commands still being written sort last, so nothing is due if they are all we have
+        if (deadlines.empty() || deadlines.begin()->first == sent_request::NO_EXPIRY)
+        {
+            event_del(timeout_timer.get());
+            return;
+        }
+
+        auto delta = deadlines.begin()->first - get_time();
+
+        timeval tv;
+        if (delta > 0s)
+        {
+            delta += 999ns;  // Round up to the next µs (libevent timers have µs precision)
+            tv.tv_sec = delta / 1s;
+            tv.tv_usec = (delta % 1s) / 1us;
+        }
+        else
+        {
+            tv.tv_sec = 0;
+            tv.tv_usec = 0;
+        }
+        event_add(timeout_timer.get(), &tv);
     }
 
     void BTRequestStream::receive(bstring_view data)
@@ -109,6 +463,24 @@ namespace oxen::quic
         }
     }
 
+    void BTRequestStream::receive_slice(stream_slice data)
+    {
+        log::trace(bp_cat, "bparser recv slice callback called!");
+
+        if (is_closing())
+            return;
+
+        try
+        {
+            process_incoming(data.view<char>(), &data);
+        }
+        catch (const std::exception& e)
+        {
+            log::error(bp_cat, "Exception caught: {}", e.what());
+            close(BPARSER_ERROR_EXCEPTION);
+        }
+    }
+
     void BTRequestStream::closed(uint64_t app_code)
     {
         log::debug(bp_cat, "bparser closed with {}", quic_strerror(app_code));
@@ -117,41 +489,83 @@ namespace oxen::quic
         // being closed and so they can never be answered.
         check_timeouts(std::nullopt);
 
+        // Streamed message writers waiting to write more can't send anything any more either
+        writable_waiters.clear();
+
+        // Likewise nobody will receive responses to the requests we are still handling
+        decltype(cancel_callbacks) callbacks;
+        {
+            std::lock_guard lock{cancel_mut};
+            all_cancelled = true;
+            callbacks.swap(cancel_callbacks);
+            cancelled_rids.clear();
+        }
+        for (auto& [rid, cb] : callbacks)
+            run_cancel_callback(rid, cb);
+
         Stream::close(app_code);
     }
 
     void BTRequestStream::register_handler(std::string ep, std::function<void(message)> func)
     {
         endpoint.call(
-                [this, ep = std::move(ep), func = std::move(func)]() mutable { func_map[std::move(ep)] = std::move(func); });
+                [this, ep = std::move(ep), func = std::move(func)]() mutable {
+                    func_map[std::move(ep)] = std::make_shared<const std::function<void(message)>>(std::move(func));
+                });
     }
 
     void BTRequestStream::register_generic_handler(std::function<void(message)> request_handler)
     {
         log::debug(bp_cat, "Bparser set generic request handler");
-        endpoint.call([this, func = std::move(request_handler)]() mutable { generic_handler = std::move(func); });
+        endpoint.call([this, func = std::move(request_handler)]() mutable {
+            generic_handler = func ? std::make_shared<const std::function<void(message)>>(std::move(func)) : nullptr;
+        });
+    }
+
+    void BTRequestStream::set_router(std::shared_ptr<const bt_router> r)
+    {
+        log::debug(bp_cat, "Bparser set shared endpoint router");
+        endpoint.call([this, r = std::move(r)]() mutable { router = std::move(r); });
     }
 
     void BTRequestStream::handle_input(message msg)
     {
         log::trace(bp_cat, "{} called to handle {} input", __PRETTY_FUNCTION__, msg.type());
 
-        if (auto type = msg.type(); type == message::TYPE_REPLY || type == message::TYPE_ERROR)
+        if (auto type = msg.type();
+            type == message::TYPE_REPLY || type == message::TYPE_ERROR || type == message::TYPE_REPLY_CHUNK)
         {
             log::trace(log_cat, "Looking for request with req_id={}", msg.req_id);
-            // Iterate using forward iterators, s.t. we go highest (newest) rids to lowest (oldest) rids.
-            // As a result, our comparator checks if the sent request ID is greater thanthan the target rid
-            auto itr = std::lower_bound(
-                    sent_reqs.begin(),
-                    sent_reqs.end(),
-                    msg.req_id,
-                    [](const std::shared_ptr<sent_request>& sr, int64_t rid) { return sr->req_id < rid; });
-
-            if (itr != sent_reqs.end())
+
+            if (auto itr = sent_reqs.find(msg.req_id); itr != sent_reqs.end())
             {
                 log::debug(bp_cat, "Successfully matched response to sent request!");
-                auto req = std::move(*itr);
-                sent_reqs.erase(itr);
+                std::shared_ptr<sent_request> req;
+
+                // If this was the next request due to time out then the timer needs to move on
+                bool was_next = deadlines.begin()->second == msg.req_id;
+                deadlines.erase({itr->second->expiry, msg.req_id});
+
+                if (msg.is_last())
+                {
+                    req = std::move(itr->second);
+                    sent_reqs.erase(itr);
+                }
+                else
+                {
+                    // More chunks of a streamed response are still to come: the timeout now applies
+                    // to the wait for the next one (unless we are still writing a streamed command,
+                    // in which case it starts when that finishes).
+                    req = itr->second;
+                    if (req->expiry != sent_request::NO_EXPIRY)
+                        req->expiry = get_time() + req->timeout.value_or(DEFAULT_TIMEOUT);
+                    deadlines.emplace(req->expiry, req->req_id);
+                    was_next = true;
+                }
+
+                if (was_next)
+                    schedule_timeout();
+
                 try
                 {
                     req->cb(std::move(msg));
@@ -160,30 +574,97 @@ namespace oxen::quic
                 {
                     log::error(bp_cat, "Uncaught exception from response handler: {}", e.what());
                 }
+
+                if (close_when_done && sent_reqs.empty() && !is_closing())
+                    close();
             }
             return;
         }
 
-        // `msg` likely isn't valid in the exception handlers below, so extract what we need to
-        // send a response anyway:
-        const auto req_id = msg.req_id;
-        const auto ep = msg.endpoint_str();
-        try
+        if (msg.type() == message::TYPE_CANCEL)
+            return handle_cancel(msg.req_id);
+
+        // `name` is the key the handler was found under (a func_map key or router table entry),
+        // which stays valid for the handler call without copying it out of `msg`.  For a request
+        // queued on the worker pool, `held` keeps the handler alive (and, for a router handler,
+        // the router holding its name) even if it is replaced before the request runs.
+        const std::function<void(message)>* handler = nullptr;
+        std::string_view name;
+        handler_ptr held;
+        auto ep = msg.endpoint();
+        if (!func_map.empty())
         {
-            if (!func_map.empty())
+            if (auto itr = func_map.find(ep); itr != func_map.end())
             {
-                if (auto itr = func_map.find(ep); itr != func_map.end())
-                {
-                    log::debug(bp_cat, "Executing request endpoint {}", msg.endpoint());
-                    return itr->second(std::move(msg));
-                }
+                handler = itr->second.get();
+                name = itr->first;
+                if (workers)
+                    held = itr->second;
             }
-            if (generic_handler)
+        }
+        if (!handler && router)
+        {
+            if (auto* entry = router->find_entry(ep))
             {
-                log::debug(bp_cat, "Executing generic request handler for endpoint {}", msg.endpoint());
-                return generic_handler(std::move(msg));
+                handler = &entry->second;
+                name = entry->first;
+                if (workers)
+                    held = handler_ptr{router, handler};
             }
-            throw no_such_endpoint{};
+        }
+        if (!handler && generic_handler)
+        {
+            handler = generic_handler.get();
+            if (workers)
+                held = generic_handler;
+        }
+
+        if (handler && workers)
+        {
+            log::trace(bp_cat, "Queueing request handler for endpoint {} on worker pool", ep);
+            workers->post(strand, [self = weak_from_this(), h = std::move(held), name, msg = std::move(msg)]() mutable {
+                auto s = self.lock();
+                if (!s)
+                    return;
+                // Don't bother starting on a request that was cancelled while it sat in the queue
+                if (s->is_cancelled(msg.req_id))
+                {
+                    log::debug(bp_cat, "Skipping cancelled request {}", msg.req_id);
+                    s->forget_cancel(msg.req_id);
+                    return;
+                }
+                s->invoke_handler(h.get(), name, std::move(msg));
+            });
+            return;
+        }
+
+        invoke_handler(handler, name, std::move(msg));
+    }
+
+    void BTRequestStream::invoke_handler(const std::function<void(message)>* handler, std::string_view ep, message msg)
+    {
+        // `msg` likely isn't valid in the exception handlers below, so extract what we need to
+        // send a response anyway.  A matched endpoint name is passed in; without one (no handler,
+        // or the generic handler) the name comes from `msg`: if parsed in place we just hold
+        // another reference to its slice, otherwise (and only if `msg` goes to a handler) we copy it.
+        const auto req_id = msg.req_id;
+        stream_slice keep;
+        std::string ep_copy;
+        if (ep.empty())
+        {
+            keep = msg.slice;
+            ep = msg.endpoint();
+            if (handler && keep.empty())
+                ep = ep_copy = msg.endpoint_str();
+        }
+
+        try
+        {
+            if (!handler)
+                throw no_such_endpoint{};
+
+            log::debug(bp_cat, "Executing request handler for endpoint {}", ep);
+            (*handler)(std::move(msg));
         }
         catch (const no_such_endpoint&)
         {
@@ -201,7 +682,7 @@ namespace oxen::quic
         }
     }
 
-    void BTRequestStream::process_incoming(std::string_view req)
+    void BTRequestStream::process_incoming(std::string_view req, const stream_slice* slice)
     {
         log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
 
@@ -239,6 +720,17 @@ namespace oxen::quic
 
             assert(current_len > 0);  // We shouldn't get out of the above without knowing this
 
+            if (slice && buf.empty() && req.size() >= current_len)
+            {
+                // Fast path: the entire request is right here in the retained slice, so parse it in
+                // place rather than copying it into buf.
+                auto offset = static_cast<size_t>(reinterpret_cast<const std::byte*>(req.data()) - slice->data());
+                handle_input(message{*this, slice->substr(offset, current_len)});
+                req.remove_prefix(current_len);
+                current_len = 0;
+                continue;
+            }
+
             if (auto r_size = req.size() + buf.size(); r_size >= current_len)
             {
                 // We have enough data for a complete request, so copy whatever we need to
@@ -268,27 +760,231 @@ namespace oxen::quic
         }
     }
 
-    std::string BTRequestStream::encode_command(std::string_view endpoint, int64_t rid, bstring_view body)
+    // Prepends the bt length prefix to the list header `hdr` of a request with a `body_size` body
+    static std::string prepend_length(std::string_view hdr, size_t body_size)
     {
-        oxenc::bt_list_producer btlp;
+        auto len = std::to_string(hdr.size() + body_size + sent_request::TRAILER.size());
+        std::string out;
+        out.reserve(len.size() + 1 + hdr.size());
+        out += len;
+        out += ':';
+        out += hdr;
+        return out;
+    }
 
-        btlp.append(message::TYPE_COMMAND);
-        btlp.append(rid);
-        btlp.append(endpoint);
-        btlp.append(body);
+    std::string BTRequestStream::encode_command(std::string_view endpoint, int64_t rid, size_t body_size)
+    {
+        return prepend_length(
+                "l{}:{}i{}e{}:{}{}:"_format(
+                        message::TYPE_COMMAND.size(), message::TYPE_COMMAND, rid, endpoint.size(), endpoint, body_size),
+                body_size);
+    }
 
-        return std::move(btlp).str();
+    std::string BTRequestStream::encode_response(int64_t rid, size_t body_size, bool error)
+    {
+        auto type = error ? message::TYPE_ERROR : message::TYPE_REPLY;
+        return prepend_length("l{}:{}i{}e{}:"_format(type.size(), type, rid, body_size), body_size);
     }
 
-    std::string BTRequestStream::encode_response(int64_t rid, bstring_view body, bool error)
+    std::string BTRequestStream::encode_chunk(
+            const std::optional<std::string>& ep, int64_t rid, size_t body_size, bool fin)
     {
-        oxenc::bt_list_producer btlp;
+        if (ep)
+            return prepend_length(
+                    "l{}:{}i{}e{}:{}i{}e{}:"_format(
+                            message::TYPE_COMMAND_CHUNK.size(),
+                            message::TYPE_COMMAND_CHUNK,
+                            rid,
+                            ep->size(),
+                            *ep,
+                            int{fin},
+                            body_size),
+                    body_size);
 
-        btlp.append(error ? message::TYPE_ERROR : message::TYPE_REPLY);
-        btlp.append(rid);
-        btlp.append(body);
+        return prepend_length(
+                "l{}:{}i{}ei{}e{}:"_format(
+                        message::TYPE_REPLY_CHUNK.size(), message::TYPE_REPLY_CHUNK, rid, int{fin}, body_size),
+                body_size);
+    }
+
+    void BTRequestStream::send_chunk(
+            const std::optional<std::string>& ep,
+            int64_t rid,
+            bstring_view chunk,
+            bool fin,
+            std::shared_ptr<void> keep_alive)
+    {
+        log::trace(bp_cat, "{} called", __PRETTY_FUNCTION__);
 
-        return std::move(btlp).str();
+        if (fin && !ep)
+            forget_cancel(rid);
+        send_request(sent_request{*this, encode_chunk(ep, rid, chunk.size(), fin), chunk, rid, std::move(keep_alive)});
+
+        // Deferred, as in cancel(), so that the command has been registered by the time this runs
+        if (fin && ep)
+            endpoint.call_soon([self = weak_from_this(), rid] {
+                if (auto s = self.lock())
+                    s->start_timeout(rid);
+            });
+    }
+
+    void BTRequestStream::start_timeout(int64_t rid)
+    {
+        auto itr = sent_reqs.find(rid);
+        if (itr == sent_reqs.end() || itr->second->expiry != sent_request::NO_EXPIRY)
+            return;  // Already answered, timed out, or cancelled
+
+        auto& req = *itr->second;
+        deadlines.erase({req.expiry, rid});
+        req.expiry = get_time() + req.timeout.value_or(DEFAULT_TIMEOUT);
+        if (deadlines.emplace(req.expiry, rid).first == deadlines.begin())
+            schedule_timeout();
+    }
+
+    void BTRequestStream::add_writable_waiter(size_t low_water, std::function<void()> cb)
+    {
+        endpoint.call([this, low_water, cb = std::move(cb)]() mutable {
+            if (is_closing())
+                return;
+
+            // Deferred even when already writable, so that a callback that writes and then waits
+            // again doesn't recurse
+            if (size() <= low_water)
+                endpoint.call_soon(std::move(cb));
+            else
+                writable_waiters.emplace_back(low_water, std::move(cb));
+        });
+    }
+
+    void BTRequestStream::on_acked()
+    {
+        if (writable_waiters.empty())
+            return;
+
+        // Pull out the ready callbacks first, since they are likely to wait again
+        auto unacked = size();
+        std::vector<std::function<void()>> ready;
+        for (auto it = writable_waiters.begin(); it != writable_waiters.end();)
+        {
+            if (unacked <= it->first)
+            {
+                ready.push_back(std::move(it->second));
+                it = writable_waiters.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        for (auto& cb : ready)
+        {
+            try
+            {
+                cb();
+            }
+            catch (const std::exception& e)
+            {
+                log::error(bp_cat, "Uncaught exception from stream writable callback: {}", e.what());
+            }
+        }
+    }
+
+    void BTRequestStream::cancel(int64_t rid)
+    {
+        // Deferred (rather than `call`ed) so that a request still waiting in the send queue, e.g.
+        // because of auto-corking, has been registered by the time this runs.
+        endpoint.call_soon([self = weak_from_this(), rid] {
+            auto s = self.lock();
+            if (!s)
+                return;
+
+            auto itr = s->sent_reqs.find(rid);
+            if (itr == s->sent_reqs.end())
+                return;  // Already answered or timed out
+
+            log::debug(bp_cat, "Cancelling request {}", rid);
+            bool was_next = s->deadlines.begin()->second == rid;
+            s->deadlines.erase({itr->second->expiry, rid});
+            s->sent_reqs.erase(itr);
+            if (was_next)
+                s->schedule_timeout();
+
+            if (s->is_closing())
+                return;
+            s->send_cancel(rid);
+
+            if (s->close_when_done && s->sent_reqs.empty())
+                s->close();
+        });
+    }
+
+    void BTRequestStream::send_cancel(int64_t rid)
+    {
+        send_request(sent_request{
+                *this,
+                prepend_length("l{}:{}i{}e0:"_format(message::TYPE_CANCEL.size(), message::TYPE_CANCEL, rid), 0),
+                bstring_view{},
+                rid});
+    }
+
+    void BTRequestStream::handle_cancel(int64_t rid)
+    {
+        log::debug(bp_cat, "Remote cancelled request {}", rid);
+
+        std::function<void()> cb;
+        {
+            std::lock_guard lock{cancel_mut};
+            if (auto itr = cancel_callbacks.find(rid); itr != cancel_callbacks.end())
+            {
+                cb = std::move(itr->second);
+                cancel_callbacks.erase(itr);
+            }
+            // We can't tell a cancellation of a request we've already answered from one we haven't,
+            // so keep the record bounded by forgetting the oldest (i.e. lowest) request ids.
+            cancelled_rids.insert(rid);
+            if (cancelled_rids.size() > MAX_CANCELLED)
+                cancelled_rids.erase(cancelled_rids.begin());
+        }
+
+        if (cb)
+            run_cancel_callback(rid, cb);
+    }
+
+    bool BTRequestStream::is_cancelled(int64_t rid)
+    {
+        std::lock_guard lock{cancel_mut};
+        return all_cancelled || cancelled_rids.count(rid);
+    }
+
+    void BTRequestStream::on_cancel(int64_t rid, std::function<void()> cb)
+    {
+        {
+            std::lock_guard lock{cancel_mut};
+            if (!all_cancelled && !cancelled_rids.count(rid))
+            {
+                cancel_callbacks[rid] = std::move(cb);
+                return;
+            }
+        }
+        run_cancel_callback(rid, cb);
+    }
+
+    void BTRequestStream::forget_cancel(int64_t rid)
+    {
+        std::lock_guard lock{cancel_mut};
+        cancel_callbacks.erase(rid);
+        cancelled_rids.erase(rid);
+    }
+
+    void BTRequestStream::run_cancel_callback(int64_t rid, const std::function<void()>& cb)
+    {
+        try
+        {
+            cb();
+        }
+        catch (const std::exception& e)
+        {
+            log::error(bp_cat, "Uncaught exception from cancellation callback of request {}: {}", rid, e.what());
+        }
     }
 
     sent_request* BTRequestStream::add_sent_request(std::shared_ptr<sent_request> req)
@@ -313,7 +1009,11 @@ namespace oxen::quic
             }
             return nullptr;
         }
-        return sent_reqs.emplace_back(std::move(req)).get();
+        auto [it, ok] = deadlines.emplace(req->expiry, req->req_id);
+        assert(ok);
+        if (it == deadlines.begin())
+            schedule_timeout();
+        return sent_reqs.emplace(req->req_id, std::move(req)).first->second.get();
     }
 
     /** Returns:
@@ -362,4 +1062,11 @@ namespace oxen::quic
         return call_get_accessor(&BTRequestStream::num_pending_impl);
     }
 
+    size_t BTRequestStream::num_pending_impl() const
+    {
+        // Everything up to `acked` has been acknowledged (and dropped from the stream's buffers)
+        auto acked = sent_total - size();
+        return msg_ends.end() - std::upper_bound(msg_ends.begin(), msg_ends.end(), acked);
+    }
+
 }  // namespace oxen::quic
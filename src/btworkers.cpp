@@ -0,0 +1,103 @@
+#include "btworkers.hpp"
+
+#include <stdexcept>
+
+#include "internal.hpp"
+
+namespace oxen::quic
+{
+    inline auto bw_cat = oxen::log::Cat("bworkers");
+
+    namespace detail
+    {
+        // Shared between the pool and its workers, so that it outlives the pool object if the pool
+        // happens to be destroyed from one of its own workers.
+        struct bt_worker_state
+        {
+            std::mutex mut;
+            std::condition_variable cv;
+            std::deque<std::shared_ptr<bt_strand>> ready;
+            bool stopping{false};
+
+            void run()
+            {
+                std::unique_lock lock{mut};
+                while (true)
+                {
+                    cv.wait(lock, [this] { return stopping || !ready.empty(); });
+                    if (ready.empty())
+                        return;  // stopping, and everything has been drained
+
+                    auto strand = std::move(ready.front());
+                    ready.pop_front();
+                    auto job = std::move(strand->jobs.front());
+                    strand->jobs.pop_front();
+
+                    lock.unlock();
+                    try
+                    {
+                        job();
+                    }
+                    catch (const std::exception& e)
+                    {
+                        log::error(bw_cat, "Uncaught exception from BT worker job: {}", e.what());
+                    }
+                    job = nullptr;
+                    lock.lock();
+
+                    // Requeue at the back (rather than running the strand's next job right away) so
+                    // that one busy stream can't monopolize a worker.
+                    if (strand->jobs.empty())
+                        strand->active = false;
+                    else
+                    {
+                        ready.push_back(std::move(strand));
+                        cv.notify_one();
+                    }
+                }
+            }
+        };
+    }  // namespace detail
+
+    bt_worker_pool::bt_worker_pool(size_t n) : state{std::make_shared<detail::bt_worker_state>()}
+    {
+        if (n == 0)
+            throw std::invalid_argument{"bt_worker_pool requires at least one thread"};
+
+        threads.reserve(n);
+        for (size_t i = 0; i < n; i++)
+            threads.emplace_back([st = state] { st->run(); });
+
+        log::debug(bw_cat, "Started BT worker pool with {} threads", n);
+    }
+
+    bt_worker_pool::~bt_worker_pool()
+    {
+        {
+            std::lock_guard lock{state->mut};
+            state->stopping = true;
+        }
+        state->cv.notify_all();
+
+        for (auto& t : threads)
+        {
+            if (t.get_id() == std::this_thread::get_id())
+                t.detach();
+            else
+                t.join();
+        }
+    }
+
+    void bt_worker_pool::post(const std::shared_ptr<detail::bt_strand>& strand, std::function<void()> job)
+    {
+        {
+            std::lock_guard lock{state->mut};
+            strand->jobs.push_back(std::move(job));
+            if (strand->active)
+                return;
+            strand->active = true;
+            state->ready.push_back(strand);
+        }
+        state->cv.notify_one();
+    }
+}  // namespace oxen::quic
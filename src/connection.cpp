@@ -8,6 +8,7 @@
 #include <memory>
 #include <random>
 #include <stdexcept>
+#include <utility>
 
 #include "datagram.hpp"
 #include "endpoint.hpp"
@@ -54,6 +55,12 @@ namespace oxen::quic
             return static_cast<Connection*>(user_data)->ack_datagram(dgram_id);
         }
 
+        static int on_lost_datagram(ngtcp2_conn* /* conn */, uint64_t dgram_id, void* user_data)
+        {
+            log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+            return static_cast<Connection*>(user_data)->lost_datagram(dgram_id);
+        }
+
         static int on_recv_datagram(
                 ngtcp2_conn* /* conn */, uint32_t flags, const uint8_t* data, size_t datalen, void* user_data)
         {
@@ -731,6 +738,13 @@ namespace oxen::quic
         });
     }
 
+    detail::recv_block_pool& Connection::recv_pool()
+    {
+        if (!_recv_pool)
+            _recv_pool = std::make_shared<detail::recv_block_pool>();
+        return *_recv_pool;
+    }
+
     stream_data_callback Connection::get_default_data_callback() const
     {
         return context->stream_data_cb;
@@ -748,6 +762,9 @@ namespace oxen::quic
             return;
 
         schedule_packet_retransmit(ts);
+
+        if (_dgram_acked || _dgram_lost)
+            report_datagram_delivery();
     }
 
     // RAII class for calling ngtcp2_conn_update_pkt_tx_timer.  If you don't call cancel() on
@@ -853,6 +870,9 @@ namespace oxen::quic
             return;
         }
 
+        // Discard any queued datagrams that have been waiting too long to be worth sending
+        datagrams->expire(tp);
+
         std::list<IOChannel*> channels;
         if (!_streams.empty())
         {
@@ -864,7 +884,7 @@ namespace oxen::quic
             for (auto it = mid; it != _streams.end(); ++it)
             {
                 auto& stream_ptr = it->second;
-                if (stream_ptr and not stream_ptr->_sent_fin)
+                if (stream_ptr and not stream_ptr->_sent_fin and stream_ptr != _dgram_stream)
                     channels.push_back(stream_ptr.get());
             }
 
@@ -878,9 +898,13 @@ namespace oxen::quic
             for (auto it = _streams.begin(); it != mid; ++it)
             {
                 auto& stream_ptr = it->second;
-                if (stream_ptr and not stream_ptr->_sent_fin)
+                if (stream_ptr and not stream_ptr->_sent_fin and stream_ptr != _dgram_stream)
                     channels.push_back(stream_ptr.get());
             }
+
+            // The datagram fallback stream only gets whatever room is left after everything else
+            if (_dgram_stream and not _dgram_stream->_sent_fin)
+                channels.push_back(_dgram_stream.get());
         }
         else if (not datagrams->is_empty())
         {
@@ -977,7 +1001,7 @@ namespace oxen::quic
                 if (datagram_accepted != 0)
                 {
                     log::trace(log_cat, "ngtcp2 accepted datagram ID: {} for transmission", dgram.id);
-                    datagrams->send_buffer.drop_front(prefer_big_first);
+                    datagrams->drop_front(prefer_big_first);
                 }
             }
 
@@ -1136,6 +1160,18 @@ namespace oxen::quic
             return 0;
         }
 
+        if (!ngtcp2_is_bidi_stream(id))
+        {
+            // The only unidirectional stream we let the remote open is its datagram fallback stream
+            auto stream = make_datagram_receiver();
+            stream->_stream_id = id;
+            stream->set_ready();
+            log::debug(log_cat, "Remote opened datagram fallback stream {}", id);
+            [[maybe_unused]] auto [it, ins] = _streams.emplace(id, std::move(stream));
+            assert(ins);
+            return 0;
+        }
+
         auto stream = construct_stream(nullptr, id);
 
         stream->_stream_id = id;
@@ -1175,7 +1211,6 @@ namespace oxen::quic
     void Connection::stream_closed(int64_t id, uint64_t app_code)
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
-        assert(ngtcp2_is_bidi_stream(id));
         log::info(log_cat, "Stream {} closed with code {}", id, app_code);
         auto it = _streams.find(id);
 
@@ -1185,11 +1220,20 @@ namespace oxen::quic
         auto& stream = *it->second;
         stream_execute_close(stream, app_code);
 
+        if (it->second == _dgram_stream)
+            // Reopened on the next datagram that needs it
+            _dgram_stream.reset();
+
         log::info(log_cat, "Erasing stream {}", id);
         _streams.erase(it);
 
         if (!ngtcp2_conn_is_local_stream(conn.get(), id))
-            ngtcp2_conn_extend_max_streams_bidi(conn.get(), 1);
+        {
+            if (ngtcp2_is_bidi_stream(id))
+                ngtcp2_conn_extend_max_streams_bidi(conn.get(), 1);
+            else
+                ngtcp2_conn_extend_max_streams_uni(conn.get(), 1);
+        }
 
         packet_io_ready();
     }
@@ -1259,10 +1303,15 @@ namespace oxen::quic
 
         log::trace(log_cat, "Stream (ID: {}) received data: {}", id, buffer_printer{data});
 
+        const bool retained = str->retains_data();
+
         std::optional<uint64_t> error;
         try
         {
-            str->receive(data);
+            if (retained)
+                str->receive_slice(str->make_slice(data, fin));
+            else
+                str->receive(data);
         }
         catch (const application_stream_error& e)
         {
@@ -1304,7 +1353,7 @@ namespace oxen::quic
             log::info(log_cat, "Stream {} closed by remote", str->_stream_id);
             // no clean up, close_cb called after this
         }
-        else
+        else if (!retained)  // Retained data returns its credit once released (see Stream::return_credit)
         {
             if (str->_paused)
                 str->_paused_offset += data.size();
@@ -1316,18 +1365,52 @@ namespace oxen::quic
         return 0;
     }
 
-    // this callback is defined for debugging datagrams
+    // these are only registered with ngtcp2 when there is a delivery callback (or, for acks, in debug builds)
     int Connection::ack_datagram(uint64_t dgram_id)
     {
         log::trace(log_cat, "Connection (CID: {}) acked datagram ID:{}", _source_cid, dgram_id);
+        _dgram_acked++;
         return 0;
     }
 
+    int Connection::lost_datagram(uint64_t dgram_id)
+    {
+        log::trace(log_cat, "Connection (CID: {}) lost datagram ID:{}", _source_cid, dgram_id);
+        _dgram_lost++;
+        return 0;
+    }
+
+    void Connection::report_datagram_delivery()
+    {
+        auto acked = std::exchange(_dgram_acked, 0);
+        auto lost = std::exchange(_dgram_lost, 0);
+
+        if (!datagrams->dgram_delivery_cb)
+            return;
+
+        try
+        {
+            datagrams->dgram_delivery_cb(*di, acked, lost);
+        }
+        catch (const std::exception& e)
+        {
+            log::warning(
+                    log_cat,
+                    "Connection (CID: {}) datagram delivery callback raised exception: {}",
+                    _source_cid,
+                    e.what());
+        }
+        catch (...)
+        {
+            log::warning(log_cat, "Connection (CID: {}) datagram delivery callback raised unknown exception", _source_cid);
+        }
+    }
+
     int Connection::recv_datagram(bstring_view data, bool fin)
     {
         log::trace(log_cat, "Connection (CID: {}) received datagram: {}", _source_cid, buffer_printer{data});
 
-        std::optional<bstring> maybe_data;
+        std::optional<bstring_view> maybe_data;
 
         if (_packet_splitting)
         {
@@ -1342,6 +1425,16 @@ namespace oxen::quic
 
             if (dgid % 4 == 0)
                 log::trace(log_cat, "Datagram sent unsplit, bypassing rotating buffer");
+            else if (dgid % 4 == 1)
+            {
+                maybe_data = datagrams->to_fragments(data, dgid);
+
+                if (not maybe_data)
+                {
+                    log::trace(log_cat, "Fragmented datagram (ID: {}) awaiting more fragments", dgid);
+                    return 0;
+                }
+            }
             else
             {
                 // send received datagram to rotating_buffer if packet_splitting is enabled
@@ -1356,7 +1449,63 @@ namespace oxen::quic
             }
         }
 
-        if (!datagrams->dgram_data_cb)
+        std::optional<bstring_view> payload = maybe_data.value_or(data);
+        std::optional<bstring_view> recovered;
+
+        if (datagrams->fec_in)
+        {
+            // Strips the FEC header; parity datagrams (and duplicates) don't get delivered themselves, but can complete
+            // the recovery of an earlier lost datagram.
+            payload = datagrams->fec_in->receive(*payload);
+            recovered = datagrams->fec_in->take_recovered();
+        }
+
+        if (payload)
+            if (auto rv = deliver_datagram(*payload); rv != 0)
+                return rv;
+
+        if (recovered)
+        {
+            log::debug(log_cat, "Connection (CID: {}) recovered lost datagram via FEC", _source_cid);
+            if (auto rv = deliver_datagram(*recovered); rv != 0)
+                return rv;
+        }
+
+        if (fin)
+        {
+            log::info(log_cat, "Connection (CID: {}) received fin from remote", _source_cid);
+            // TODO: no clean up, as close cb is called after? Or just for streams
+        }
+
+        return 0;
+    }
+
+    int Connection::deliver_datagram(bstring_view data)
+    {
+        datagram_flow* flow = nullptr;
+
+        if (datagrams->flows_enabled())
+        {
+            auto flow_id = datagrams->read_flow_id(data);
+            if (!flow_id)
+                return 0;
+            if (*flow_id != 0)
+            {
+                if (*flow_id < datagrams->flows.size())
+                    flow = datagrams->flows[*flow_id].get();
+                if (!flow)
+                {
+                    log::debug(
+                            log_cat,
+                            "Connection (CID: {}) dropping datagram for unregistered flow {}",
+                            _source_cid,
+                            *flow_id);
+                    return 0;
+                }
+            }
+        }
+
+        if (!flow && !datagrams->dgram_data_cb && !datagrams->dgram_view_cb)
             log::debug(log_cat, "Connection (CID: {}) has no endpoint-supplied datagram data callback", _source_cid);
         else
         {
@@ -1364,7 +1513,12 @@ namespace oxen::quic
 
             try
             {
-                datagrams->dgram_data_cb(*di, (maybe_data ? std::move(*maybe_data) : bstring{data.begin(), data.end()}));
+                if (flow)
+                    flow->recv_cb(*di, data);
+                else if (datagrams->dgram_view_cb)
+                    datagrams->dgram_view_cb(*di, data);
+                else
+                    datagrams->dgram_data_cb(*di, bstring{data});
                 good = true;
             }
             catch (const std::exception& e)
@@ -1392,12 +1546,6 @@ namespace oxen::quic
             }
         }
 
-        if (fin)
-        {
-            log::info(log_cat, "Connection (CID: {}) received fin from remote", _source_cid);
-            // TODO: no clean up, as close cb is called after? Or just for streams
-        }
-
         return 0;
     }
 
@@ -1410,29 +1558,186 @@ namespace oxen::quic
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
 
-        if (!_datagrams_enabled)
+        if (!_datagrams_enabled && !_dgram_fallback)
             throw std::runtime_error{"Endpoint not configured for datagram IO"};
 
         datagrams->send(data, std::move(keep_alive));
     }
 
+    void Connection::send_datagram(bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb)
+    {
+        log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+
+        if (!_datagrams_enabled && !_dgram_fallback)
+            throw std::runtime_error{"Endpoint not configured for datagram IO"};
+
+        datagrams->send_one(data, std::move(keep_alive), std::move(sent_cb));
+    }
+
+    void Connection::send_flow_datagram(uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive)
+    {
+        log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+
+        if (!_datagrams_enabled && !_dgram_fallback)
+            throw std::runtime_error{"Endpoint not configured for datagram IO"};
+
+        datagrams->send_flow(flow_id, data, std::move(keep_alive));
+    }
+
+    void Connection::send_flow_datagram(
+            uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb)
+    {
+        log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+
+        if (!_datagrams_enabled && !_dgram_fallback)
+            throw std::runtime_error{"Endpoint not configured for datagram IO"};
+
+        datagrams->send_flow(flow_id, data, std::move(keep_alive), std::move(sent_cb));
+    }
+
+    void Connection::register_datagram_flow_impl(
+            uint16_t flow_id, dgram_view_callback recv_cb, int priority, std::optional<opt::datagram_queue> limits)
+    {
+        if (!_datagrams_enabled && !_dgram_fallback)
+            throw std::runtime_error{"Endpoint not configured for datagram IO"};
+
+        datagrams->register_flow(
+                flow_id, std::move(recv_cb), priority, limits ? *limits : _endpoint.datagram_queue_limits());
+    }
+
+    void Connection::send_datagrams(std::span<const bstring_view> data, std::shared_ptr<void> keep_alive)
+    {
+        log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+
+        if (!_datagrams_enabled && !_dgram_fallback)
+            throw std::runtime_error{"Endpoint not configured for datagram IO"};
+
+        datagrams->send_batch(std::vector<bstring_view>{data.begin(), data.end()}, std::move(keep_alive));
+    }
+
     uint64_t Connection::get_streams_available_impl() const
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
         return ngtcp2_conn_get_streams_bidi_left(conn.get());
     }
 
+    datagram_queue_stats Connection::get_datagram_queue_stats_impl() const
+    {
+        return datagrams->queue_stats();
+    }
+
+    datagram_reassembly_stats Connection::get_datagram_reassembly_stats_impl() const
+    {
+        return datagrams->recv_buffer.stats();
+    }
+
+    bool Connection::remote_datagrams_supported() const
+    {
+        auto* params = ngtcp2_conn_get_remote_transport_params(conn.get());
+        return !params || params->max_datagram_frame_size > 0;
+    }
+
+    bool Connection::send_datagram_via_stream(bstring_view data, bstring_view prefix)
+    {
+        assert(_endpoint.in_event_loop());
+
+        const auto size = prefix.size() + data.size();
+        if (size > std::numeric_limits<uint16_t>::max())
+        {
+            log::warning(log_cat, "Unable to send datagram of length {} over fallback stream: too large", size);
+            return false;
+        }
+
+        if (!_dgram_stream)
+        {
+            auto stream = _endpoint.make_shared<Stream>(*this, _endpoint);
+            if (int rv = ngtcp2_conn_open_uni_stream(conn.get(), &stream->_stream_id, stream.get()); rv != 0)
+            {
+                log::warning(
+                        log_cat,
+                        "Unable to open datagram fallback stream ({}); remote does not support it",
+                        ngtcp2_strerror(rv));
+                return false;
+            }
+            stream->set_ready();
+            log::debug(log_cat, "Opened datagram fallback stream {}", stream->_stream_id);
+            _dgram_stream = _streams[stream->_stream_id] = std::move(stream);
+        }
+
+        bstring frame;
+        frame.reserve(2 + size);
+        frame.resize(2);
+        oxenc::write_host_as_big(static_cast<uint16_t>(size), frame.data());
+        frame.append(prefix);
+        frame.append(data);
+        _dgram_stream->send(std::move(frame));
+        return true;
+    }
+
+    std::shared_ptr<Stream> Connection::make_datagram_receiver()
+    {
+        // Holds the start of a frame split across stream data callbacks
+        auto partial = std::make_shared<bstring>();
+
+        stream_data_callback on_data = [this, partial](Stream&, bstring_view data) {
+            auto deliver = [this](bstring_view dgram) {
+                if (deliver_datagram(dgram) != 0)
+                    throw std::runtime_error{"datagram callback failed"};
+            };
+
+            if (!partial->empty())
+            {
+                // Complete the pending frame first, copying only as much as it needs
+                if (partial->size() < 2)
+                {
+                    auto n = std::min(data.size(), 2 - partial->size());
+                    partial->append(data.substr(0, n));
+                    data.remove_prefix(n);
+                    if (partial->size() < 2)
+                        return;
+                }
+                size_t need = 2 + oxenc::load_big_to_host<uint16_t>(partial->data()) - partial->size();
+                auto n = std::min(need, data.size());
+                partial->append(data.substr(0, n));
+                data.remove_prefix(n);
+                if (n < need)
+                    return;
+                deliver(bstring_view{*partial}.substr(2));
+                partial->clear();
+            }
+
+            while (data.size() >= 2)
+            {
+                size_t len = oxenc::load_big_to_host<uint16_t>(data.data());
+                if (data.size() < 2 + len)
+                    break;
+                deliver(data.substr(2, len));
+                data.remove_prefix(2 + len);
+            }
+
+            partial->assign(data);
+        };
+
+        return _endpoint.make_shared<Stream>(*this, _endpoint, std::move(on_data));
+    }
+
     size_t Connection::get_max_datagram_size_impl()
     {
         if (!_datagrams_enabled)
             return 0;
 
-        // If packet splitting, we can take in double the datagram size
-        size_t multiple = (_packet_splitting) ? 2 : 1;
-        // Minus packet splitting overhead that adds 2 bytes of overhead per full or half datagram:
-        size_t adjustment = DATAGRAM_OVERHEAD + (_packet_splitting ? 2 : 0);
+        // If packet splitting, we can take in double the datagram size (or more, with fragmentation)
+        size_t multiple = datagrams->max_fragments;
+        // Minus packet splitting overhead that adds 2 bytes of overhead per full or half datagram, and fragmentation
+        // that adds one more byte per fragment:
+        size_t adjustment = DATAGRAM_OVERHEAD + (_packet_splitting ? 2 : 0) + (multiple > 2 ? 1 : 0);
 
         size_t max_dgram_size = multiple * (ngtcp2_conn_get_path_max_tx_udp_payload_size(conn.get()) - adjustment);
+        // Flow IDs and FEC framing are added on top of the whole (not yet split) datagram
+        if (datagrams->flows_enabled())
+            max_dgram_size -= DatagramIO::FLOW_ID_OVERHEAD;
+        if (datagrams->fec_out)
+            max_dgram_size -= fec_encoder::OVERHEAD;
         if (max_dgram_size != _last_max_dgram_size)
         {
             _max_dgram_size_changed = true;
@@ -1499,8 +1804,9 @@ namespace oxen::quic
 
         // Connection flow level control window
         params.initial_max_data = 15_Mi;
-        // Max concurrent streams supported on one connection
-        params.initial_max_streams_uni = 0;
+        // Max concurrent streams supported on one connection; the only unidirectional stream we accept is the remote's
+        // datagram fallback stream.
+        params.initial_max_streams_uni = _dgram_fallback ? 1 : 0;
         // Max send buffer for streams (local = streams we initiate, remote = streams initiated to us)
         params.initial_max_stream_data_bidi_local = 6_Mi;
         params.initial_max_stream_data_bidi_remote = 6_Mi;
@@ -1522,11 +1828,14 @@ namespace oxen::quic
             settings.max_tx_udp_payload_size = MAX_PMTUD_UDP_PAYLOAD;                // 1500 - 48 (approximate overhead)
             // settings.no_tx_udp_payload_size_shaping = 1;
             callbacks.recv_datagram = Callbacks::on_recv_datagram;
+            if (datagrams->dgram_delivery_cb)
+            {
+                callbacks.ack_datagram = Callbacks::on_ack_datagram;
+                callbacks.lost_datagram = Callbacks::on_lost_datagram;
+            }
 #ifndef NDEBUG
             callbacks.ack_datagram = Callbacks::on_ack_datagram;
 #endif
-
-            di = _endpoint.make_shared<dgram_interface>(*this);
         }
         else
         {
@@ -1535,6 +1844,9 @@ namespace oxen::quic
             callbacks.recv_datagram = nullptr;
         }
 
+        if (_datagrams_enabled || _dgram_fallback)
+            di = _endpoint.make_shared<dgram_interface>(*this);
+
         return 0;
     }
 
@@ -1562,6 +1874,7 @@ namespace oxen::quic
             _max_streams{context->config.max_streams ? context->config.max_streams : DEFAULT_MAX_BIDI_STREAMS},
             _datagrams_enabled{context->config.datagram_support},
             _packet_splitting{context->config.split_packet},
+            _dgram_fallback{ep.datagram_fallback_enabled()},
             tls_creds{context->tls_creds}
     {
         // If a connection_{established/closed}_callback was passed to IOContext via `Endpoint::{listen,connect}(...)`...
@@ -1576,8 +1889,14 @@ namespace oxen::quic
                                ? is_outbound() ? std::move(context->conn_closed_cb) : context->conn_closed_cb
                                : nullptr;
 
+        // Either kind of datagram callback given to the context overrides both endpoint-level callbacks
+        const bool ctx_dgram_cb = context->dgram_data_cb || context->dgram_view_cb;
         datagrams = _endpoint.make_shared<DatagramIO>(
-                *this, _endpoint, context->dgram_data_cb ? context->dgram_data_cb : ep.dgram_recv_cb);
+                *this,
+                _endpoint,
+                ctx_dgram_cb ? context->dgram_data_cb : ep.dgram_recv_cb,
+                ctx_dgram_cb ? context->dgram_view_cb : ep.dgram_view_recv_cb);
+        datagrams->dgram_delivery_cb = context->dgram_delivery_cb ? context->dgram_delivery_cb : ep.dgram_delivery_cb;
         pseudo_stream = _endpoint.make_shared<Stream>(*this, _endpoint);
         pseudo_stream->_stream_id = -1;
 
@@ -1735,19 +2054,34 @@ namespace oxen::quic
             ngtcp2_cid* ocid)
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
-        std::shared_ptr<Connection> conn{new Connection{
-                ep,
-                rid,
-                scid,
-                dcid,
-                path,
-                std::move(ctx),
-                alpns,
-                default_handshake_timeout,
-                remote_pk,
-                hdr,
-                token_type,
-                ocid}};
+
+        // Connections (and their control blocks) come from the loop's slab pool, like streams; unlike loop-created
+        // objects, though, they are destroyed directly by whoever drops the last reference.
+        const auto& pool = ep.net._loop->pool();
+        void* mem = pool->allocate(sizeof(Connection));
+        Connection* ptr;
+        try
+        {
+            ptr = new (mem) Connection{
+                    ep,
+                    rid,
+                    scid,
+                    dcid,
+                    path,
+                    std::move(ctx),
+                    alpns,
+                    default_handshake_timeout,
+                    remote_pk,
+                    hdr,
+                    token_type,
+                    ocid};
+        }
+        catch (...)
+        {
+            pool->deallocate(mem, sizeof(Connection));
+            throw;
+        }
+        std::shared_ptr<Connection> conn{ptr, slab_deleter<Connection>{pool}, slab_allocator<Connection>{pool}};
 
         conn->packet_io_ready();
 
@@ -1799,6 +2133,22 @@ namespace oxen::quic
         return endpoint().call_get([this]() -> int { return get_max_datagram_size_impl(); });
     }
 
+    datagram_queue_stats connection_interface::get_datagram_queue_stats()
+    {
+        return endpoint().call_get([this] { return get_datagram_queue_stats_impl(); });
+    }
+
+    datagram_reassembly_stats connection_interface::get_datagram_reassembly_stats()
+    {
+        return endpoint().call_get([this] { return get_datagram_reassembly_stats_impl(); });
+    }
+
+    void connection_interface::register_datagram_flow(
+            uint16_t flow_id, dgram_view_callback recv_cb, int priority, std::optional<opt::datagram_queue> limits)
+    {
+        endpoint().call_get([&] { register_datagram_flow_impl(flow_id, std::move(recv_cb), priority, limits); });
+    }
+
     connection_interface::~connection_interface()
     {
         log::trace(log_cat, "connection_interface @{} destroyed", (void*)this);
@@ -72,6 +72,18 @@ namespace oxen::quic
         dgram_data_cb = std::move(func);
     }
 
+    void IOContext::handle_ioctx_opt(opt::dgram_views dv)
+    {
+        log::trace(log_cat, "IO context stored datagram view callback");
+        dgram_view_cb = std::move(dv.callback);
+    }
+
+    void IOContext::handle_ioctx_opt(dgram_delivery_callback func)
+    {
+        log::trace(log_cat, "IO context stored datagram delivery callback");
+        dgram_delivery_cb = std::move(func);
+    }
+
     void IOContext::handle_ioctx_opt(connection_established_callback func)
     {
         log::trace(log_cat, "IO context stored connection established callback");
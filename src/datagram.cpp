@@ -7,14 +7,29 @@
 namespace oxen::quic
 {
 
-    DatagramIO::DatagramIO(Connection& c, Endpoint& e, dgram_data_callback data_cb) :
+    DatagramIO::DatagramIO(Connection& c, Endpoint& e, dgram_data_callback data_cb, dgram_view_callback view_cb) :
             IOChannel{c, e},
             dgram_data_cb{std::move(data_cb)},
+            dgram_view_cb{std::move(view_cb)},
             rbufsize{endpoint.datagram_bufsize()},
             recv_buffer{*this},
+            max_fragments{
+                    !_conn->packet_splitting_enabled()       ? uint8_t{1}
+                    : endpoint.datagram_fragmentation() ? endpoint.datagram_fragmentation()->max_fragments
+                                                        : uint8_t{2}},
             _packet_splitting(_conn->packet_splitting_enabled())
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+        send_buffer.limits = endpoint.datagram_queue_limits();
+        if (max_fragments > 2)
+            fragments.emplace(*endpoint.datagram_fragmentation());
+        if (auto k = endpoint.datagram_fec_block_size())
+        {
+            fec_out.emplace(k);
+            fec_in.emplace();
+        }
+        if (const auto& df = endpoint.datagram_flows())
+            flows.resize(df->max_flows);
     }
 
     int64_t DatagramIO::stream_id() const
@@ -47,12 +62,22 @@ namespace oxen::quic
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
         size_t sum{0};
-        if (send_buffer.empty())
-            return sum;
         for (const auto& entry : send_buffer.buf)
             sum += entry.size();
+        for (const auto* f : flows_by_priority)
+            for (const auto& entry : f->queue.buf)
+                sum += entry.size();
         return sum;
     }
+    bool DatagramIO::is_empty_impl() const
+    {
+        if (!send_buffer.empty())
+            return false;
+        for (const auto* f : flows_by_priority)
+            if (!f->queue.empty())
+                return false;
+        return true;
+    }
     bool DatagramIO::has_unsent_impl() const
     {
         return not is_empty_impl();
@@ -80,64 +105,363 @@ namespace oxen::quic
     }
 
     void DatagramIO::send_impl(bstring_view data, std::shared_ptr<void> keep_alive)
+    {
+        send_one(0, data, std::move(keep_alive), nullptr);
+    }
+
+    void DatagramIO::send_one(
+            uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb)
     {
         // if packet_splitting is lazy OR packet_splitting is off, send as "normal" datagram
-        endpoint.call([this, data, keep_alive = std::move(keep_alive)]() {
-            if (!_conn)
+        endpoint.call([this, flow_id, data, keep_alive = std::move(keep_alive), sent_cb = std::move(sent_cb)]() {
+            auto transport = dgram_transport::dropped;
+            if (_conn)
             {
+                // check this first and once; already considers policy when returning
+                transport = queue_datagram(data, std::move(keep_alive), _conn->get_max_datagram_size_impl(), flow_id);
+                if (transport == dgram_transport::datagram)
+                    _conn->packet_io_ready();
+            }
+            else
                 log::warning(log_cat, "Unable to send datagram: connection has gone away");
+
+            if (!sent_cb)
                 return;
+
+            try
+            {
+                sent_cb(transport);
             }
+            catch (const std::exception& e)
+            {
+                log::warning(log_cat, "Datagram sent callback raised exception: {}", e.what());
+            }
+        });
+    }
 
-            // check this first and once; already considers policy when returning
-            const auto max_size = _conn->get_max_datagram_size_impl();
+    void DatagramIO::send_flow(
+            uint16_t flow_id, bstring_view data, std::shared_ptr<void> keep_alive, dgram_sent_callback sent_cb)
+    {
+        if (!flows_enabled())
+            throw std::logic_error{"Unable to send datagram on a flow: datagram flows are not enabled"};
+        if (flow_id >= flows.size())
+            throw std::out_of_range{"Datagram flow ID {} is out of range"_format(flow_id)};
 
-            // we use >= instead of > for that just-in-case 1-byte cushion
-            if (data.size() > max_size)
+        send_one(flow_id, data, std::move(keep_alive), std::move(sent_cb));
+    }
+
+    void DatagramIO::send_batch(std::vector<bstring_view> dgrams, std::shared_ptr<void> keep_alive, uint16_t flow_id)
+    {
+        if (dgrams.empty())
+            return;
+
+        endpoint.call([this, dgrams = std::move(dgrams), keep_alive = std::move(keep_alive), flow_id]() {
+            if (!_conn)
             {
-                log::warning(
-                        log_cat,
-                        "Data of length {} cannot be sent with {} datagrams of max size {}",
-                        data.size(),
-                        _packet_splitting ? "unsplit" : "split",
-                        max_size);
-                // Ideally we would throw, but because we're inside a `call` and are probably
-                // running after the `send_impl` call returned, all we can really do is warn and
-                // drop.
+                log::warning(log_cat, "Unable to send datagrams: connection has gone away");
                 return;
             }
 
-            log::trace(
+            const auto max_size = _conn->get_max_datagram_size_impl();
+
+            bool queued = false;
+            for (const auto& d : dgrams)
+                queued |= queue_datagram(d, keep_alive, max_size, flow_id) == dgram_transport::datagram;
+
+            if (queued)
+                _conn->packet_io_ready();
+        });
+    }
+
+    dgram_transport DatagramIO::queue_datagram(
+            bstring_view data, std::shared_ptr<void> keep_alive, size_t max_size, uint16_t flow_id)
+    {
+        // With the stream fallback enabled, anything that can't go out as a datagram goes over the fallback stream
+        const bool via_stream = _conn->datagram_fallback_enabled()
+                             && (data.size() > max_size || !_conn->datagrams_enabled()
+                                 || !_conn->remote_datagrams_supported());
+
+        // we use >= instead of > for that just-in-case 1-byte cushion
+        if (!via_stream && data.size() > max_size)
+        {
+            log::warning(
                     log_cat,
-                    "Connection ({}) sending {} datagram: {}",
-                    _conn->reference_id(),
-                    _packet_splitting ? "split" : "whole",
-                    buffer_printer{data});
+                    "Data of length {} cannot be sent with {} datagrams of max size {}",
+                    data.size(),
+                    _packet_splitting ? "unsplit" : "split",
+                    max_size);
+            // Ideally we would throw, but because we're inside a `call` and are probably
+            // running after the `send_impl` call returned, all we can really do is warn and
+            // drop.
+            return dgram_transport::dropped;
+        }
 
-            bool split = _packet_splitting && data.size() > max_size / 2;
+        auto& queue = flow_id != 0 && flows[flow_id] ? flows[flow_id]->queue : send_buffer;
 
-            auto dgram_id = _next_dgram_counter << 2;
-            if (split)
-                dgram_id |= 0b10;
-            (++_next_dgram_counter) %= 1 << 14;
+        // The flow ID goes in front of the data.  Rather than copying the data to prefix it, it is passed along
+        // separately and goes out in the header bytes of the (first piece of the) datagram.
+        std::array<std::byte, FLOW_ID_OVERHEAD> prefix_buf;
+        bstring_view prefix;
+        if (flows_enabled())
+        {
+            max_size += FLOW_ID_OVERHEAD;
+            if (flow_id < 64)
+            {
+                prefix_buf[0] = static_cast<std::byte>(flow_id);
+                prefix = {prefix_buf.data(), 1};
+            }
+            else
+            {
+                oxenc::write_host_as_big(static_cast<uint16_t>(flow_id | 0x4000), prefix_buf.data());
+                prefix = {prefix_buf.data(), 2};
+            }
+        }
+
+        if (via_stream)
+        {
+            if (!_conn->send_datagram_via_stream(data, prefix))
+                return dgram_transport::dropped;
+            log::trace(log_cat, "Connection ({}) sent datagram over fallback stream", _conn->reference_id());
+            _via_stream++;
+            // The stream schedules its own sending
+            return dgram_transport::stream;
+        }
+
+        if (!fec_out)
+            return queue_wire_datagram(data, std::move(keep_alive), max_size, queue, prefix) ? dgram_transport::datagram
+                                                                                              : dgram_transport::dropped;
 
-            send_buffer.emplace(data, dgram_id, std::move(keep_alive), split ? dgram::OVERSIZED : dgram::STANDARD, max_size);
+        // The FEC-framed copy (which includes the flow ID) replaces the caller's data, so we no longer need to keep that
+        // alive
+        auto framed = std::make_shared<bstring>(fec_out->encode(data, prefix));
+        bool queued = queue_wire_datagram(*framed, framed, max_size + fec_encoder::OVERHEAD, queue);
 
+        // A completed block's parity datagram still needs sending even if this datagram was itself discarded
+        if (queue_parity(max_size + fec_encoder::OVERHEAD, queue) && !queued)
             _conn->packet_io_ready();
-        });
+
+        return queued ? dgram_transport::datagram : dgram_transport::dropped;
+    }
+
+    bool DatagramIO::queue_parity(size_t max_size, buffer_que& queue)
+    {
+        auto parity = fec_out->take_parity();
+        if (!parity)
+            return false;
+        auto p = std::make_shared<bstring>(std::move(*parity));
+        if (!queue_wire_datagram(*p, p, max_size, queue))
+            return false;
+        _fec_parity++;
+        return true;
+    }
+
+    bool DatagramIO::queue_wire_datagram(
+            bstring_view data, std::shared_ptr<void> keep_alive, size_t max_size, buffer_que& queue, bstring_view prefix)
+    {
+        log::trace(
+                log_cat,
+                "Connection ({}) sending {} datagram: {}",
+                _conn->reference_id(),
+                _packet_splitting ? "split" : "whole",
+                buffer_printer{data});
+
+        const auto size = prefix.size() + data.size();
+
+        // The size of a whole (unsplit) datagram, each half of a split one, or each fragment plus its extra header byte;
+        // see Connection::get_max_datagram_size_impl.
+        const size_t unit = max_fragments > 2 ? max_size / max_fragments + 1 : max_size / max_fragments;
+
+        auto type = dgram::STANDARD;
+        if (size > 2 * unit)
+            type = dgram::FRAGMENTED;
+        else if (_packet_splitting && size > unit)
+            type = dgram::OVERSIZED;
+
+        auto dgram_id = _next_dgram_counter << 2;
+        if (type == dgram::OVERSIZED)
+            dgram_id |= 0b10;
+        else if (type == dgram::FRAGMENTED)
+            dgram_id |= 0b01;
+        (++_next_dgram_counter) %= 1 << 14;
+
+        // Fragments carry `unit - 1` bytes of payload each; an oversized datagram is split in half, each half taking up
+        // (at most) a whole unit.  (`max_size` itself is the multi-fragment maximum when fragmentation is enabled, so
+        // it can't be used to split an oversized datagram).
+        return queue.emplace(
+                data,
+                dgram_id,
+                std::move(keep_alive),
+                type,
+                type == dgram::FRAGMENTED ? unit - 1 : 2 * unit,
+                prefix);
+    }
+
+    void DatagramIO::send_impl(std::vector<bstring_view> bufs, std::shared_ptr<void> keep_alive)
+    {
+        if (bufs.empty())
+            return;
+        if (bufs.size() == 1)
+            return send_impl(bufs.front(), std::move(keep_alive));
+
+        // A datagram has to go out as one contiguous piece, so we have no choice but to join the buffers here
+        size_t total = 0;
+        for (const auto& b : bufs)
+            total += b.size();
+
+        auto joined = std::make_shared<bstring>();
+        joined->reserve(total);
+        for (const auto& b : bufs)
+            joined->append(b);
+
+        bstring_view view{*joined};
+        send_impl(view, std::move(joined));
     }
 
     prepared_datagram DatagramIO::pending_datagram(bool r)
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
 
-        return send_buffer.prepare(r, _packet_splitting);
+        _sending = next_queue();
+        assert(_sending);
+        return _sending->prepare(r, _packet_splitting);
+    }
+
+    buffer_que* DatagramIO::next_queue()
+    {
+        bool checked_default = false;
+        for (auto* f : flows_by_priority)
+        {
+            if (!checked_default && f->priority <= 0)
+            {
+                if (!send_buffer.empty())
+                    return &send_buffer;
+                checked_default = true;
+            }
+            if (!f->queue.empty())
+                return &f->queue;
+        }
+        if (!checked_default && !send_buffer.empty())
+            return &send_buffer;
+        return nullptr;
+    }
+
+    void DatagramIO::drop_front(bool r)
+    {
+        assert(_sending && !_sending->empty());
+        _sending->drop_front(r);
+
+        // Once everything queued has gone out, send the parity of the FEC block the last datagrams went into, if it is at
+        // least half full, rather than leaving them unprotected until enough further datagrams come along to fill it.
+        if (fec_out && is_empty_impl())
+        {
+            fec_out->flush();
+            auto max_size = _conn->get_max_datagram_size_impl() + fec_encoder::OVERHEAD;
+            if (flows_enabled())
+                max_size += FLOW_ID_OVERHEAD;
+            queue_parity(max_size, send_buffer);
+        }
+    }
+
+    void DatagramIO::expire(std::chrono::steady_clock::time_point now)
+    {
+        send_buffer.expire(now);
+        for (auto* f : flows_by_priority)
+            f->queue.expire(now);
     }
 
-    std::optional<bstring> DatagramIO::to_buffer(bstring_view data, uint16_t dgid)
+    datagram_queue_stats DatagramIO::queue_stats() const
+    {
+        auto stats = send_buffer.stats();
+        stats.via_stream = _via_stream;
+        stats.fec_parity = _fec_parity;
+        for (const auto* f : flows_by_priority)
+        {
+            auto fs = f->queue.stats();
+            stats.queued += fs.queued;
+            stats.queued_bytes += fs.queued_bytes;
+            stats.dropped += fs.dropped;
+            stats.expired += fs.expired;
+        }
+        return stats;
+    }
+
+    void DatagramIO::register_flow(uint16_t flow_id, dgram_view_callback recv_cb, int priority, opt::datagram_queue limits)
+    {
+        if (!flows_enabled())
+            throw std::logic_error{"Unable to register datagram flow: datagram flows are not enabled"};
+        if (flow_id == 0)
+            throw std::invalid_argument{"Datagram flow 0 is the default flow and cannot be registered"};
+        if (flow_id >= flows.size())
+            throw std::out_of_range{"Datagram flow ID {} is out of range"_format(flow_id)};
+        if (flows[flow_id])
+            throw std::invalid_argument{"Datagram flow {} is already registered"_format(flow_id)};
+
+        auto& f = flows[flow_id];
+        f = std::make_unique<datagram_flow>();
+        f->recv_cb = std::move(recv_cb);
+        f->queue.limits = limits;
+        f->priority = priority;
+
+        flows_by_priority.insert(
+                std::upper_bound(
+                        flows_by_priority.begin(),
+                        flows_by_priority.end(),
+                        priority,
+                        [](int p, const datagram_flow* other) { return p > other->priority; }),
+                f.get());
+    }
+
+    std::optional<uint16_t> DatagramIO::read_flow_id(bstring_view& data) const
+    {
+        if (data.empty())
+        {
+            log::warning(log_cat, "Dropping invalid datagram: missing flow ID");
+            return std::nullopt;
+        }
+
+        uint16_t id;
+        auto prefix = static_cast<uint8_t>(data[0]) >> 6;
+        if (prefix == 0)
+        {
+            id = static_cast<uint8_t>(data[0]);
+            data.remove_prefix(1);
+        }
+        else if (prefix == 1 && data.size() >= 2)
+        {
+            id = oxenc::load_big_to_host<uint16_t>(data.data()) & 0x3fff;
+            data.remove_prefix(2);
+        }
+        else
+        {
+            log::warning(log_cat, "Dropping datagram with invalid flow ID");
+            return std::nullopt;
+        }
+
+        return id;
+    }
+
+    std::optional<bstring_view> DatagramIO::to_buffer(bstring_view data, uint16_t dgid)
     {
         log::trace(log_cat, "DatagramIO handed datagram with endian swapped ID: {}", dgid);
 
         return recv_buffer.receive(data, dgid);
     }
+
+    std::optional<bstring_view> DatagramIO::to_fragments(bstring_view data, uint16_t dgid)
+    {
+        if (!fragments)
+        {
+            log::warning(log_cat, "Dropping fragmented datagram (ID: {}): datagram fragmentation is not enabled", dgid);
+            return std::nullopt;
+        }
+        if (data.empty())
+        {
+            log::warning(log_cat, "Dropping invalid fragmented datagram (ID: {}): missing fragment header", dgid);
+            return std::nullopt;
+        }
+
+        auto header = static_cast<uint8_t>(data.front());
+        data.remove_prefix(1);
+        return fragments->receive(data, dgid, header, get_time());
+    }
 }  // namespace oxen::quic
@@ -28,11 +28,53 @@ namespace oxen::quic
         _packet_splitting = dc.split_packets;
         _policy = dc.mode;
         _rbufsize = dc.bufsize;
+        _fec_block_size = dc.fec_block_size;
 
         log::trace(
                 log_cat,
                 "User has activated endpoint datagram support with {} split-packet support",
                 _packet_splitting ? "" : "no");
+        if (_fec_block_size)
+            log::trace(log_cat, "Datagram FEC enabled with a block size of {}", _fec_block_size);
+    }
+
+    void Endpoint::handle_ep_opt(opt::datagram_queue dq)
+    {
+        log::trace(
+                log_cat,
+                "Endpoint datagram send queue limited to {} datagrams, {}B, {}ms",
+                dq.max_count,
+                dq.max_bytes,
+                dq.max_age.count());
+        _dgram_queue = dq;
+    }
+
+    void Endpoint::handle_ep_opt(opt::datagram_fragments df)
+    {
+        log::trace(log_cat, "Endpoint datagram fragmentation enabled for up to {} fragments", df.max_fragments);
+        _dgram_fragments = df;
+    }
+
+    void Endpoint::handle_ep_opt(opt::datagram_flows df)
+    {
+        log::trace(log_cat, "Endpoint datagram flows enabled for up to {} flows", df.max_flows);
+        _dgram_flows = df;
+    }
+
+    void Endpoint::handle_ep_opt(opt::adaptive_datagram_buffer ab)
+    {
+        log::trace(
+                log_cat,
+                "Endpoint datagram reassembly window adaptive between {} and {}",
+                ab.min_bufsize,
+                ab.max_bufsize);
+        _adaptive_rbuf = ab;
+    }
+
+    void Endpoint::handle_ep_opt(opt::datagram_fallback)
+    {
+        log::trace(log_cat, "Endpoint datagram stream fallback enabled");
+        _dgram_fallback = true;
     }
 
     void Endpoint::handle_ep_opt(opt::outbound_alpns alpns)
@@ -62,6 +104,18 @@ namespace oxen::quic
         dgram_recv_cb = std::move(func);
     }
 
+    void Endpoint::handle_ep_opt(opt::dgram_views dv)
+    {
+        log::trace(log_cat, "Endpoint given datagram view recv callback");
+        dgram_view_recv_cb = std::move(dv.callback);
+    }
+
+    void Endpoint::handle_ep_opt(dgram_delivery_callback func)
+    {
+        log::trace(log_cat, "Endpoint given datagram delivery callback");
+        dgram_delivery_cb = std::move(func);
+    }
+
     void Endpoint::handle_ep_opt(connection_established_callback conn_established_cb)
     {
         log::trace(log_cat, "Endpoint given connection established callback");
@@ -1,5 +1,7 @@
 #include "messages.hpp"
 
+#include <bit>
+
 #include "connection.hpp"
 #include "datagram.hpp"
 #include "endpoint.hpp"
@@ -7,20 +9,39 @@
 
 namespace oxen::quic
 {
-    rotating_buffer::rotating_buffer(DatagramIO& d) : datagram{d}, bufsize{d.rbufsize}, rowsize{d.rbufsize / 4}
+    rotating_buffer::rotating_buffer(DatagramIO& d) :
+            datagram{d},
+            bufsize{d.endpoint.datagram_buffer_adaptation() ? d.endpoint.datagram_buffer_adaptation()->min_bufsize
+                                                              : d.rbufsize},
+            rowsize{bufsize / 4},
+            adaptive{d.endpoint.datagram_buffer_adaptation()}
     {
-        for (auto& v : buf)
-            v.resize(rowsize);
+        for (auto& o : occupied)
+            o.resize((rowsize + 63) / 64);
     }
 
-    std::optional<bstring> rotating_buffer::receive(bstring_view data, uint16_t dgid)
+    std::optional<bstring_view> rotating_buffer::receive(bstring_view data, uint16_t dgid)
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
 
         assert(datagram.endpoint.in_event_loop());
         assert(datagram._conn);
 
+        if (data.size() > SLOT_SIZE)
+        {
+            log::warning(log_cat, "Dropping split datagram (ID: {}): too large ({}B)", dgid, data.size());
+            return std::nullopt;
+        }
+
         auto idx = dgid >> 2;
+        observe(idx);
+
+        if (!slab)
+        {
+            slab.reset(new std::byte[(static_cast<size_t>(bufsize) + 2) * SLOT_SIZE]);
+            slots.resize(bufsize);
+        }
+
         log::trace(
                 log_cat,
                 "dgid: {}, row: {}, col: {}, idx: {}, rowsize: {}, bufsize {}",
@@ -34,9 +55,18 @@ namespace oxen::quic
         row = (idx % bufsize) / rowsize;
         col = idx % rowsize;
 
-        auto& b = buf[row][col];
+        auto& b = slots[slot_index(row, col)];
 
-        if (b)
+        if (is_held(row, col) && b.idx != idx)
+        {
+            // A half of some older datagram that maps to the same slot and is never going to be matched now
+            log::debug(log_cat, "Evicting unmatched datagram half (counter: {}) at buffer pos [{},{}]", b.idx, row, col);
+            unset_held(row, col);
+            currently_held[row] -= 1;
+            evicted++;
+        }
+
+        if (is_held(row, col))
         {
             if (datagram._conn->debug_datagram_drop_enabled)
             {
@@ -54,33 +84,38 @@ namespace oxen::quic
                     log_cat,
                     "Pairing datagram (ID: {}) with {} half at buffer pos [{},{}]",
                     dgid,
-                    (b->part < 0 ? "first"s : "second"s),
+                    (b.part < 0 ? "first"s : "second"s),
                     row,
                     col);
 
-            bstring out;
-            out.reserve(b->data_size + data.size());
-            if (b->part < 0)
+            auto* out = reassembly_buffer();
+            const auto* held = slot_data(row, col);
+            if (b.part < 0)
             {  // We have the first part already
-                out.append(b->data.data(), b->data_size);
-                out.append(data);
+                std::memcpy(out, held, b.size);
+                std::memcpy(out + b.size, data.data(), data.size());
             }
             else
             {
-                out.append(data);
-                out.append(b->data.data(), b->data_size);
+                std::memcpy(out, data.data(), data.size());
+                std::memcpy(out + data.size(), held, b.size);
             }
-            b.reset();
+            unset_held(row, col);
 
             currently_held[row] -= 1;
+            paired++;
 
-            return out;
+            return bstring_view{out, b.size + data.size()};
         }
 
         // Otherwise: new piece
         log::trace(log_cat, "Storing datagram (ID: {}) at buffer pos [{},{}]", dgid, row, col);
 
-        b = std::make_unique<received_datagram>(dgid, data);
+        std::memcpy(slot_data(row, col), data.data(), data.size());
+        b.size = static_cast<uint16_t>(data.size());
+        b.idx = idx;
+        b.part = (dgid % 4 == 2) ? int8_t{-1} : int8_t{1};
+        set_held(row, col);
         currently_held[row] += 1;
 
         int to_clear = (row + 2) % 4;
@@ -95,11 +130,89 @@ namespace oxen::quic
         return std::nullopt;
     }
 
-    void buffer_que::emplace(bstring_view pload, uint16_t p_id, std::shared_ptr<void> data, dgram type, size_t max_size)
+    bool buffer_que::emplace(
+            bstring_view pload,
+            uint16_t p_id,
+            std::shared_ptr<void> data,
+            dgram type,
+            size_t max_size,
+            bstring_view prefix)
+    {
+        const auto size = pload.size() + prefix.size();
+        if (over_limit(size))
+        {
+            // Evicting is pointless if the new datagram wouldn't fit even with nothing else queued (apart from a split
+            // datagram that is already half sent, which is never discarded), e.g. because it alone exceeds max_bytes.
+            const bool pinned = !buf.empty() && buf.front().in_progress();
+            const bool can_fit = (!limits.max_bytes || (pinned ? buf.front().total_size : 0) + size <= limits.max_bytes)
+                              && (!limits.max_count || (pinned ? 1u : 0u) + 1 <= limits.max_count);
+
+            if (can_fit && limits.policy == opt::datagram_queue::drop::OLDEST)
+            {
+                // Make room by discarding from the front, skipping a split datagram that is already half sent
+                auto it = buf.begin();
+                while (over_limit(size) && it != buf.end())
+                {
+                    if (it->in_progress())
+                        ++it;
+                    else
+                    {
+                        log::trace(log_cat, "Datagram send queue full; dropping oldest datagram (ID: {})", it->pload_id);
+                        auto i = it - buf.begin();
+                        pop(it);
+                        it = buf.begin() + i;
+                        _dropped++;
+                    }
+                }
+            }
+
+            if (over_limit(size))
+            {
+                log::trace(log_cat, "Datagram send queue full; dropping new datagram (ID: {})", p_id);
+                _dropped++;
+                return false;
+            }
+        }
+
+        auto& d = buf.emplace_back(datagram_storage::make(pload, p_id, std::move(data), type, max_size, prefix));
+        d.total_size = pload.size() + prefix.size();
+        if (limits.max_age > 0ms)
+            d.expiry = get_time() + limits.max_age;
+        _bytes += d.total_size;
+
+        return true;
+    }
+
+    bool buffer_que::over_limit(size_t extra_bytes) const
     {
-        auto d_storage = datagram_storage::make(pload, p_id, std::move(data), type, max_size);
+        return (limits.max_count && buf.size() + 1 > limits.max_count) ||
+               (limits.max_bytes && _bytes + extra_bytes > limits.max_bytes);
+    }
 
-        buf.push_back(std::move(d_storage));
+    void buffer_que::pop(std::deque<datagram_storage>::iterator it)
+    {
+        _bytes -= it->total_size;
+        buf.erase(it);
+    }
+
+    void buffer_que::expire(std::chrono::steady_clock::time_point now)
+    {
+        if (limits.max_age == 0ms)
+            return;
+
+        // Deadlines are assigned in queue order, so we only ever have to look at the front (or just past a half-sent
+        // split datagram at the front)
+        auto it = buf.begin();
+        if (it != buf.end() && it->in_progress())
+            ++it;
+        while (it != buf.end() && it->expiry <= now)
+        {
+            log::trace(log_cat, "Datagram (ID: {}) expired before it could be sent; dropping", it->pload_id);
+            auto i = it - buf.begin();
+            pop(it);
+            it = buf.begin() + i;
+            _expired++;
+        }
     }
 
     void buffer_que::drop_front(bool b)
@@ -108,8 +221,15 @@ namespace oxen::quic
 
         if (f.type == dgram::STANDARD)
         {
-            f.payload.reset();
-            buf.pop_front();
+            pop(buf.begin());
+            return;
+        }
+
+        if (f.type == dgram::FRAGMENTED)
+        {
+            f.payload->remove_prefix(std::min<size_t>(f.frag_payload_size(), f.payload->size()));
+            if (++f.frag_next == f.frag_count)
+                pop(buf.begin());
             return;
         }
 
@@ -124,16 +244,119 @@ namespace oxen::quic
         }
 
         assert(f.empty());
-        buf.pop_front();
+        pop(buf.begin());
     }
 
     void rotating_buffer::clear_row(int index)
     {
         log::trace(log_cat, "Clearing buffer row {} (i = {}, j = {})", index, row, col);
 
-        for (auto& b : buf[index])
-            if (b)
-                b.reset();
+        for (auto& bits : occupied[index])
+        {
+            evicted += std::popcount(bits);
+            bits = 0;
+        }
+    }
+
+    void rotating_buffer::observe(uint16_t idx)
+    {
+        // Counters are 14 bits and wrap around, so compare them as serial numbers
+        if (high_idx < 0)
+            high_idx = idx;
+        uint16_t depth = (high_idx - idx) & 0x3fff;
+        if (depth >= 1 << 13)
+        {
+            // newer than anything seen so far
+            high_idx = idx;
+            depth = 0;
+        }
+
+        max_depth = std::max(max_depth, depth);
+        epoch_depth = std::max(epoch_depth, depth);
+
+        if (!adaptive)
+            return;
+
+        // A half is guaranteed to be held for at least a row's worth of IDs; grow if we are getting within half of that
+        if (2 * depth > rowsize && bufsize < adaptive->max_bufsize)
+        {
+            int target = bufsize;
+            while (target < adaptive->max_bufsize && target / 4 < 2 * depth)
+                target *= 2;
+            resize(target);
+        }
+        else if (++epoch_count >= ADAPT_EPOCH)
+        {
+            if (bufsize > adaptive->min_bufsize && 8 * epoch_depth < rowsize)
+                resize(bufsize / 2);
+            epoch_count = 0;
+            epoch_depth = 0;
+        }
+    }
+
+    void rotating_buffer::resize(int new_bufsize)
+    {
+        log::debug(log_cat, "Resizing datagram reassembly window from {} to {}", bufsize, new_bufsize);
+
+        auto old_slab = std::move(slab);
+        auto old_slots = std::move(slots);
+        auto old_occupied = std::move(occupied);
+        const int old_rowsize = rowsize;
+
+        bufsize = new_bufsize;
+        rowsize = new_bufsize / 4;
+        for (auto& o : occupied)
+            o.assign((rowsize + 63) / 64, 0);
+        currently_held = {0, 0, 0, 0};
+        slots.clear();
+        resized++;
+        epoch_count = 0;
+        epoch_depth = 0;
+
+        if (!old_slab)
+            // Nothing received yet: the new slab gets allocated on first use
+            return;
+
+        slab.reset(new std::byte[(static_cast<size_t>(bufsize) + 2) * SLOT_SIZE]);
+        slots.resize(bufsize);
+
+        auto behind = [this](uint16_t i) { return (high_idx - i) & 0x3fff; };
+
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < old_rowsize; c++)
+            {
+                if (!(old_occupied[r][c / 64] & (uint64_t{1} << (c % 64))))
+                    continue;
+
+                auto old_pos = static_cast<size_t>(r) * old_rowsize + c;
+                const auto& ob = old_slots[old_pos];
+                int nr = (ob.idx % bufsize) / rowsize, nc = ob.idx % rowsize;
+                auto& nb = slots[slot_index(nr, nc)];
+
+                if (is_held(nr, nc))
+                {
+                    // Two held halves collide in the smaller window: keep the newer one
+                    evicted++;
+                    if (behind(ob.idx) > behind(nb.idx))
+                        continue;
+                }
+                else
+                {
+                    set_held(nr, nc);
+                    currently_held[nr] += 1;
+                }
+
+                std::memcpy(slot_data(nr, nc), old_slab.get() + old_pos * SLOT_SIZE, ob.size);
+                nb = ob;
+            }
+        }
+
+        // Pick up the row clearing cycle from the row of the newest datagram in the new layout
+        int to_clear = ((high_idx % bufsize) / rowsize + 2) % 4;
+        clear_row(to_clear);
+        currently_held[to_clear] = 0;
+        last_cleared = to_clear;
     }
 
     int rotating_buffer::datagrams_stored() const
@@ -146,6 +369,9 @@ namespace oxen::quic
         if (type == dgram::STANDARD)
             return {*payload, pload_id, -1, true};
 
+        if (type == dgram::FRAGMENTED)
+            return {payload->substr(0, frag_payload_size()), pload_id, -1, frag_next + 1 == frag_count};
+
         if (payload && not addendum)
             return {*payload, pload_id, -1, true};
         else if (addendum && not payload)
@@ -162,22 +388,38 @@ namespace oxen::quic
 
         prepared_datagram d{};
 
-        outbound_dgram out = buf.front().fetch(b);
+        auto& front = buf.front();
+        outbound_dgram out = front.fetch(b);
         d.id = out.id;
-        d.bufs_len = 1;
+        d.bufs_len = 0;
         d.is_empty = out.is_empty;
 
-        oxenc::write_host_as_big(out.id, d.dgid.data());
-
+        size_t hdr_len = 0;
         if (is_splitting)
+        {
+            oxenc::write_host_as_big(out.id, d.dgid.data());
+            hdr_len = 2;
+            if (front.type == dgram::FRAGMENTED)
+                d.dgid[hdr_len++] = make_fragment_header(front.frag_next, front.frag_count);
+        }
+
+        // The flow ID goes with the first piece of the datagram
+        if (front.prefix_len && out.type < 0 && (front.type != dgram::FRAGMENTED || front.frag_next == 0))
+        {
+            std::memcpy(d.dgid.data() + hdr_len, front.prefix.data(), front.prefix_len);
+            hdr_len += front.prefix_len;
+        }
+
+        if (hdr_len)
         {
             d.bufs[0].base = d.dgid.data();
-            d.bufs[0].len = 2;
+            d.bufs[0].len = hdr_len;
             d.bufs_len++;
         }
 
-        d.bufs[d.bufs_len - 1].base = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(out.data.data()));
-        d.bufs[d.bufs_len - 1].len = out.data.size();
+        d.bufs[d.bufs_len].base = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(out.data.data()));
+        d.bufs[d.bufs_len].len = out.data.size();
+        d.bufs_len++;
 
         log::trace(
                 log_cat,
@@ -190,19 +432,312 @@ namespace oxen::quic
     }
 
     datagram_storage datagram_storage::make(
-            bstring_view pload, uint16_t d_id, std::shared_ptr<void> data, dgram type, size_t max_size)
+            bstring_view pload,
+            uint16_t d_id,
+            std::shared_ptr<void> data,
+            dgram type,
+            size_t max_size,
+            bstring_view prefix)
     {
+        assert(prefix.size() <= std::tuple_size_v<decltype(datagram_storage::prefix)>);
+        auto with_prefix = [&](datagram_storage&& d) {
+            d.prefix_len = static_cast<uint8_t>(prefix.size());
+            std::memcpy(d.prefix.data(), prefix.data(), prefix.size());
+            return std::move(d);
+        };
+
         if (type == dgram::STANDARD)
-            return datagram_storage(pload, d_id, std::move(data));
+            return with_prefix(datagram_storage(pload, d_id, std::move(data)));
 
         assert(max_size != 0);
 
-        auto half_size = max_size / 2;
+        if (type == dgram::FRAGMENTED)
+        {
+            assert(d_id % 4 == 1);
+            auto d = with_prefix(datagram_storage(pload, d_id, std::move(data)));
+            d.type = dgram::FRAGMENTED;
+            d.frag_size = static_cast<uint16_t>(max_size);
+            d.frag_count = static_cast<uint8_t>((prefix.size() + pload.size() + max_size - 1) / max_size);
+            assert(d.frag_count > 2 && d.frag_count <= opt::datagram_fragments::MAX_FRAGMENTS);
+            return d;
+        }
+
+        // The prefix goes out with the first half, so takes up some of its room
+        auto half_size = max_size / 2 - prefix.size();
         auto first_half = pload.substr(0, half_size), second_half = pload.substr(half_size);
 
         assert(d_id % 4 == 2);
 
-        return datagram_storage(first_half, second_half, d_id, d_id + 1, std::move(data));
+        return with_prefix(datagram_storage(first_half, second_half, d_id, d_id + 1, std::move(data)));
+    }
+
+    std::optional<bstring_view> fragment_reassembler::receive(
+            bstring_view data, uint16_t dgid, uint8_t header, std::chrono::steady_clock::time_point now)
+    {
+        // Whatever we returned last time is no longer needed
+        if (completed)
+            free_bufs.push_back(std::move(completed));
+
+        uint8_t index = header >> 4, count = (header & 0x0f) + 1;
+        if (count < 3 || count > config.max_fragments || index >= count || data.size() > SLOT_SIZE)
+        {
+            log::warning(
+                    log_cat,
+                    "Dropping invalid datagram fragment (ID: {}, fragment {}/{}, size {})",
+                    dgid,
+                    index,
+                    count,
+                    data.size());
+            return std::nullopt;
+        }
+
+        // Throw away anything that has been waiting too long for its remaining fragments
+        for (auto it = partial.begin(); it != partial.end();)
+        {
+            if (now - it->started >= config.reassembly_timeout)
+            {
+                log::debug(log_cat, "Incomplete fragmented datagram (ID: {}) timed out", it->id);
+                it = release(it);
+                expired++;
+            }
+            else
+                ++it;
+        }
+
+        auto it = std::find_if(partial.begin(), partial.end(), [&](const auto& p) { return p.id == dgid; });
+        if (it == partial.end())
+        {
+            if (partial.size() >= config.max_partial)
+            {
+                // Evict the oldest (which, since we always append, is the first one)
+                log::debug(log_cat, "Too many incomplete fragmented datagrams; dropping ID {}", partial.front().id);
+                release(partial.begin());
+                evicted++;
+            }
+            auto& p = partial.emplace_back();
+            p.id = dgid;
+            p.count = count;
+            p.started = now;
+            p.buf = get_buffer();
+            it = std::prev(partial.end());
+        }
+        else if (it->count != count)
+        {
+            log::warning(log_cat, "Dropping datagram fragment (ID: {}) with mismatched fragment count", dgid);
+            return std::nullopt;
+        }
+
+        uint16_t bit = uint16_t{1} << index;
+        if (it->have & bit)
+        {
+            log::debug(log_cat, "Ignoring duplicate datagram fragment {} (ID: {})", index, dgid);
+            return std::nullopt;
+        }
+
+        std::memcpy(it->buf.get() + index * SLOT_SIZE, data.data(), data.size());
+        it->sizes[index] = static_cast<uint16_t>(data.size());
+        it->have |= bit;
+
+        if (it->have != (1 << count) - 1)
+            return std::nullopt;
+
+        // Complete: compact the fragments down into a contiguous datagram (each move is to an equal or lower address,
+        // so moving in order never clobbers a fragment we still need).
+        auto* out = it->buf.get();
+        size_t size = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            std::memmove(out + size, out + i * SLOT_SIZE, it->sizes[i]);
+            size += it->sizes[i];
+        }
+
+        completed = std::move(it->buf);
+        partial.erase(it);
+
+        return bstring_view{completed.get(), size};
+    }
+
+    std::unique_ptr<std::byte[]> fragment_reassembler::get_buffer()
+    {
+        if (!free_bufs.empty())
+        {
+            auto b = std::move(free_bufs.back());
+            free_bufs.pop_back();
+            return b;
+        }
+        return std::unique_ptr<std::byte[]>{new std::byte[config.max_fragments * SLOT_SIZE]};
+    }
+
+    std::vector<fragment_reassembler::partial_dgram>::iterator fragment_reassembler::release(
+            std::vector<partial_dgram>::iterator it)
+    {
+        free_bufs.push_back(std::move(it->buf));
+        return partial.erase(it);
+    }
+
+    bstring fec_encoder::encode(bstring_view body, bstring_view prefix)
+    {
+        bstring framed;
+        framed.reserve(HEADER_SIZE + prefix.size() + body.size());
+        framed.resize(HEADER_SIZE);
+        oxenc::write_host_as_big(block, framed.data());
+        framed[2] = static_cast<std::byte>(index);
+        framed[3] = std::byte{0};
+        framed.append(prefix);
+        framed.append(body);
+
+        // The parity covers everything following the FEC header
+        auto data = bstring_view{framed}.substr(HEADER_SIZE);
+
+        if (acc.size() < data.size())
+            acc.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+            acc[i] ^= data[i];
+        len_xor ^= static_cast<uint16_t>(data.size());
+
+        if (++index == block_size)
+            finish_block();
+
+        return framed;
+    }
+
+    void fec_encoder::flush()
+    {
+        if (index > 0 && 2 * index >= block_size)
+            finish_block();
+    }
+
+    void fec_encoder::finish_block()
+    {
+        auto& p = parity.emplace();
+        p.reserve(HEADER_SIZE + 2 + acc.size());
+        p.resize(HEADER_SIZE + 2);
+        oxenc::write_host_as_big(block, p.data());
+        p[2] = static_cast<std::byte>(index);
+        p[3] = static_cast<std::byte>(index);
+        oxenc::write_host_as_big(len_xor, p.data() + HEADER_SIZE);
+        p.append(acc);
+
+        acc.clear();
+        len_xor = 0;
+        index = 0;
+        block++;
+    }
+
+    std::optional<bstring_view> fec_decoder::receive(bstring_view data)
+    {
+        if (data.size() < fec_encoder::HEADER_SIZE)
+        {
+            log::warning(log_cat, "Dropping invalid datagram: too short for FEC header");
+            return std::nullopt;
+        }
+
+        auto id = oxenc::load_big_to_host<uint16_t>(data.data());
+        auto index = static_cast<uint8_t>(data[2]);
+        auto count = static_cast<uint8_t>(data[3]);
+        data.remove_prefix(fec_encoder::HEADER_SIZE);
+
+        bool is_parity = count != 0;
+        if (is_parity ? (count > opt::enable_datagrams::fec::MAX_BLOCK_SIZE || data.size() < 2)
+                      : index >= opt::enable_datagrams::fec::MAX_BLOCK_SIZE)
+        {
+            log::warning(log_cat, "Dropping invalid FEC datagram (block {}, index {}, count {})", id, index, count);
+            return std::nullopt;
+        }
+
+        auto* b = get_block(id);
+        if (!b)
+        {
+            log::trace(log_cat, "Received FEC datagram for expired block {}", id);
+            return is_parity ? std::nullopt : std::make_optional(data);
+        }
+
+        if (is_parity)
+        {
+            if (b->have_parity)
+                return std::nullopt;
+            b->have_parity = true;
+            b->count = count;
+            b->len_xor ^= oxenc::load_big_to_host<uint16_t>(data.data());
+            data.remove_prefix(2);
+            if (!b->done)
+            {
+                add(b->acc, data);
+                try_recover(*b);
+            }
+            return std::nullopt;
+        }
+
+        auto bit = uint64_t{1} << index;
+        if (b->have & bit)
+            // Already received, or already recovered
+            return std::nullopt;
+        b->have |= bit;
+        b->received++;
+        if (!b->done)
+        {
+            b->len_xor ^= static_cast<uint16_t>(data.size());
+            add(b->acc, data);
+            try_recover(*b);
+        }
+        return data;
+    }
+
+    fec_decoder::block_state* fec_decoder::get_block(uint16_t id)
+    {
+        auto& b = blocks[id % WINDOW];
+        if (b.active && b.id == id)
+            return &b;
+        // Serial number comparison (so that this keeps working when the block counter wraps): a
+        // block older than the one in its slot has already been given up on.
+        if (b.active && static_cast<int16_t>(id - b.id) < 0)
+            return nullptr;
+
+        b.id = id;
+        b.active = true;
+        b.count = 0;
+        b.have_parity = false;
+        b.done = false;
+        b.received = 0;
+        b.have = 0;
+        b.len_xor = 0;
+        b.acc.clear();
+        return &b;
+    }
+
+    void fec_decoder::add(bstring& acc, bstring_view data)
+    {
+        if (acc.size() < data.size())
+            acc.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+            acc[i] ^= data[i];
+    }
+
+    void fec_decoder::try_recover(block_state& b)
+    {
+        if (!b.have_parity)
+            return;
+        if (b.received >= b.count)
+        {
+            b.done = true;
+            return;
+        }
+        if (b.received + 1 < b.count)
+            return;
+
+        // Exactly one datagram is missing: the XOR of the parity and everything else we received is
+        // the missing one (and the same goes for its length).
+        b.done = true;
+        if (b.len_xor > b.acc.size())
+        {
+            log::warning(log_cat, "Unable to recover datagram of FEC block {}: invalid parity length", b.id);
+            return;
+        }
+        auto missing = std::countr_one(b.have);
+        b.have |= uint64_t{1} << missing;
+        total_recovered++;
+        log::trace(log_cat, "Recovered datagram {} of FEC block {}", missing, b.id);
+        recovered.emplace(b.acc.data(), b.len_xor);
     }
 
 }  // namespace oxen::quic
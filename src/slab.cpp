@@ -0,0 +1,65 @@
+#include "slab.hpp"
+
+namespace oxen::quic
+{
+    void* slab_pool::allocate(size_t size)
+    {
+        size = round_up(size);
+
+        std::lock_guard lock{mut};
+        _stats.allocs++;
+        auto& sc = classes[size];
+
+        void* p;
+        if (!sc.free.empty())
+        {
+            p = sc.free.back();
+            sc.free.pop_back();
+            _stats.reused++;
+        }
+        else
+        {
+            if (sc.remaining == 0)
+            {
+                auto chunks = std::max<size_t>(1, SLAB_SIZE / size);
+                auto bytes = chunks * size;
+                auto& slab = slabs.emplace_back(
+                        new std::max_align_t[(bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+                sc.next = reinterpret_cast<std::byte*>(slab.get());
+                sc.remaining = chunks;
+                sc.total += chunks;
+                // Make sure the free list can hold every chunk of this size so that deallocate never has to allocate
+                sc.free.reserve(sc.total);
+                _stats.slabs++;
+                _stats.reserved += bytes;
+            }
+            p = sc.next;
+            sc.next += size;
+            sc.remaining--;
+        }
+
+        _stats.in_use++;
+        return p;
+    }
+
+    void slab_pool::deallocate(void* p, size_t size) noexcept
+    {
+        if (!p)
+            return;
+
+        size = round_up(size);
+
+        std::lock_guard lock{mut};
+        // Can't allocate: the free list has room for every chunk ever carved out for this size (see `allocate`)
+        auto& sc = classes.find(size)->second;
+        sc.free.push_back(p);
+        _stats.in_use--;
+    }
+
+    slab_pool::stats_t slab_pool::stats() const
+    {
+        std::lock_guard lock{mut};
+        return _stats;
+    }
+
+}  // namespace oxen::quic
@@ -5,9 +5,18 @@ extern "C"
 #include <ngtcp2/ngtcp2.h>
 }
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <stdexcept>
+#include <system_error>
+#include <utility>
 
 #include "connection.hpp"
 #include "context.hpp"
@@ -40,6 +49,7 @@ namespace oxen::quic
     Stream::~Stream()
     {
         log::trace(log_cat, "Destroying stream {}", _stream_id);
+        release_recv_block();
     }
 
     void Stream::set_watermark(
@@ -132,6 +142,186 @@ namespace oxen::quic
         return endpoint.call_get([this]() { return _paused; });
     }
 
+    void Stream::set_data_provider(stream_view_provider provider, std::function<void(Stream&)> done)
+    {
+        if (!provider)
+            throw std::invalid_argument{"Stream::set_data_provider requires a valid provider!"};
+
+        endpoint.call([this, provider = std::move(provider), done = std::move(done)]() mutable {
+            if (_is_closing || _is_shutdown || _sent_fin)
+            {
+                log::warning(log_cat, "Failed to set data provider; stream is not active!");
+                return;
+            }
+
+            log::debug(log_cat, "Stream (ID: {}) set data provider", _stream_id);
+            _provider = std::move(provider);
+            _provider_done = std::move(done);
+
+            if (_ready && _conn)
+                _conn->packet_io_ready();
+        });
+    }
+
+    namespace
+    {
+        // The buffers handed to a stream_buffer_provider.  Successive pulls are given consecutive pieces of a block, each
+        // piece keeping the block alive until it has been acknowledged; blocks that are no longer referenced by any
+        // unacknowledged data are then reused, rather than allocating (and zero-filling) a new buffer for every pull.
+        struct provider_buffers
+        {
+            static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+            std::vector<std::shared_ptr<std::byte[]>> blocks;
+            size_t current{0};
+            size_t used{BLOCK_SIZE};
+
+            // Returns the block to write into next, and the space available in it (at most `budget`)
+            std::pair<std::shared_ptr<std::byte[]>, std::span<std::byte>> next(size_t budget)
+            {
+                if (used == BLOCK_SIZE)
+                {
+                    // Only we hold a reference to a block once everything written into it has been acked
+                    auto it = std::find_if(blocks.begin(), blocks.end(), [](const auto& b) { return b.use_count() == 1; });
+                    if (it == blocks.end())
+                        it = blocks.emplace(it, new std::byte[BLOCK_SIZE]);
+                    current = it - blocks.begin();
+                    used = 0;
+                }
+
+                auto& block = blocks[current];
+                return {block, std::span<std::byte>{block.get() + used, std::min(budget, BLOCK_SIZE - used)}};
+            }
+        };
+    }  // namespace
+
+    void Stream::set_data_provider(stream_buffer_provider provider, std::function<void(Stream&)> done)
+    {
+        if (!provider)
+            throw std::invalid_argument{"Stream::set_data_provider requires a valid provider!"};
+
+        set_data_provider(
+                [provider = std::move(provider), bufs = std::make_shared<provider_buffers>()](
+                        Stream& s, size_t budget) -> std::pair<bstring_view, std::shared_ptr<void>> {
+                    auto [block, buf] = bufs->next(budget);
+                    auto n = provider(s, buf);
+                    if (n > buf.size())
+                        throw std::out_of_range{"Stream buffer provider wrote more than the supplied buffer size"};
+                    bufs->used += n;
+                    return {bstring_view{buf.data(), n}, std::move(block)};
+                },
+                std::move(done));
+    }
+
+    void Stream::clear_data_provider()
+    {
+        endpoint.call([this]() {
+            _provider = nullptr;
+            _provider_done = nullptr;
+        });
+    }
+
+    bool Stream::has_data_provider() const
+    {
+        return endpoint.call_get([this]() { return static_cast<bool>(_provider); });
+    }
+
+#ifndef _WIN32
+    namespace
+    {
+        // A read-only mapping of a region of a file; unmapped when the last reference (i.e. the last unacknowledged
+        // stream buffer pointing into it) goes away.
+        struct mapped_file_window
+        {
+            const std::byte* data;
+            size_t size;
+
+            mapped_file_window(int fd, size_t file_offset, size_t len) : size{len}
+            {
+                auto* addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(file_offset));
+                if (addr == MAP_FAILED)
+                    throw std::system_error{errno, std::system_category(), "Unable to mmap file for sending"};
+                data = static_cast<const std::byte*>(addr);
+
+                if (madvise(addr, len, MADV_SEQUENTIAL) != 0)
+                    log::debug(log_cat, "madvise(MADV_SEQUENTIAL) failed: {}", strerror(errno));
+            }
+
+            mapped_file_window(const mapped_file_window&) = delete;
+            mapped_file_window& operator=(const mapped_file_window&) = delete;
+
+            ~mapped_file_window() { munmap(const_cast<std::byte*>(data), size); }
+        };
+
+        struct file_sender
+        {
+            int fd;
+            size_t pos;
+            size_t end;
+            size_t window;
+
+            std::shared_ptr<mapped_file_window> current;
+            size_t current_offset{0};
+
+            file_sender(int fd, size_t offset, size_t len, size_t window) :
+                    fd{fd}, pos{offset}, end{offset + len}, window{window}
+            {}
+
+            file_sender(const file_sender&) = delete;
+            file_sender& operator=(const file_sender&) = delete;
+
+            ~file_sender() { ::close(fd); }
+
+            std::pair<bstring_view, std::shared_ptr<void>> next(size_t budget)
+            {
+                if (pos >= end)
+                    return {};
+
+                if (!current || pos >= current_offset + current->size)
+                {
+                    // Drop our reference to the previous window: it gets unmapped as soon as everything still pointing
+                    // into it has been acked.  mmap offsets must be page-aligned, so we may map a little bit before pos.
+                    current.reset();
+                    static const size_t page_size = sysconf(_SC_PAGESIZE);
+                    current_offset = pos - pos % page_size;
+                    current = std::make_shared<mapped_file_window>(
+                            fd, current_offset, std::min(window, end - current_offset));
+                }
+
+                auto from = pos - current_offset;
+                auto n = std::min(budget, current->size - from);
+                pos += n;
+                return {bstring_view{current->data + from, n}, current};
+            }
+        };
+    }  // namespace
+
+    void Stream::send_file(int fd, size_t offset, size_t len, std::function<void(Stream&)> done, size_t window)
+    {
+        static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            throw std::system_error{errno, std::system_category(), "Unable to stat file for sending"};
+        if (offset > static_cast<size_t>(st.st_size) || len > static_cast<size_t>(st.st_size) - offset)
+            throw std::out_of_range{"Stream::send_file range extends beyond the end of the file"};
+
+        int dupfd = ::dup(fd);
+        if (dupfd < 0)
+            throw std::system_error{errno, std::system_category(), "Unable to duplicate file descriptor for sending"};
+
+        // The window always has to cover at least one page beyond the (aligned) current position
+        window = std::max(window - window % page_size, 2 * page_size);
+
+        auto sender = std::make_shared<file_sender>(dupfd, offset, len, window);
+
+        log::debug(log_cat, "Stream (ID: {}) sending {}B of file from offset {}", _stream_id, len, offset);
+
+        set_data_provider(
+                [sender = std::move(sender)](Stream&, size_t budget) { return sender->next(budget); }, std::move(done));
+    }
+#endif
+
     bool Stream::available() const
     {
         return endpoint.call_get([this] { return !(_is_closing || _is_shutdown || _sent_fin); });
@@ -176,7 +366,11 @@ namespace oxen::quic
                 }
             }
             if (_is_shutdown)
+            {
                 data_callback = nullptr;
+                _provider = nullptr;
+                _provider_done = nullptr;
+            }
 
             if (!_conn)
             {
@@ -204,12 +398,56 @@ namespace oxen::quic
 
         _conn = nullptr;
         _is_closing = _is_shutdown = true;
+        _provider = nullptr;
+        _provider_done = nullptr;
+        release_recv_block();
+    }
+
+    stream_slice Stream::make_slice(bstring_view data, bool fin)
+    {
+        assert(_conn);
+        if (!_recv_block || !_recv_block->fits(data.size()))
+        {
+            release_recv_block();
+            _recv_block = _conn->recv_pool().get(data.size());
+            _recv_block->owner = weak_from_this();
+        }
+
+        auto* hdr = _recv_block->append(data, fin ? 0 : data.size());
+        return {hdr, reinterpret_cast<const std::byte*>(hdr + 1), data.size()};
+    }
+
+    void Stream::release_recv_block()
+    {
+        if (_recv_block)
+            detail::release_block(std::exchange(_recv_block, nullptr));
+    }
+
+    void Stream::return_credit(size_t bytes)
+    {
+        if (!endpoint.in_event_loop())
+            return endpoint.call_soon([wself = weak_from_this(), bytes]() {
+                if (auto self = wself.lock())
+                    self->return_credit(bytes);
+            });
+
+        if (!_conn || _is_shutdown)
+            return;
+
+        log::trace(log_cat, "Stream (ID: {}) retained data released; returning {}B of credit", _stream_id, bytes);
+        if (_paused)
+            _paused_offset += bytes;
+        else
+            ngtcp2_conn_extend_max_stream_offset(*_conn, _stream_id, bytes);
+        ngtcp2_conn_extend_max_offset(*_conn, bytes);
+        _conn->packet_io_ready();
     }
 
     void Stream::append_buffer(bstring_view buffer, std::shared_ptr<void> keep_alive)
     {
         log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
         user_buffers.emplace_back(buffer, std::move(keep_alive));
+        _buffered_size += buffer.size();
         assert(endpoint.in_event_loop());
         assert(_conn);
         if (_ready)
@@ -225,6 +463,7 @@ namespace oxen::quic
 
         assert(bytes <= _unacked_size);
         _unacked_size -= bytes;
+        _buffered_size -= bytes;
 
         // drop all acked user_buffers, as they are unneeded
         while (bytes >= user_buffers.front().first.size() && bytes)
@@ -238,6 +477,8 @@ namespace oxen::quic
         if (bytes)
             user_buffers.front().first.remove_prefix(bytes);
 
+        on_acked();
+
         auto sz = size();
 
         // Do not bother with this block of logic if no watermarks are set
@@ -309,6 +550,9 @@ namespace oxen::quic
 
         std::vector<ngtcp2_vec> nbufs{};
 
+        if (_provider && _ready && unsent_impl() == 0)
+            pull_from_provider();
+
         log::trace(log_cat, "unsent: {}", unsent());
 
         if (user_buffers.empty() || unsent() == 0)
@@ -329,6 +573,67 @@ namespace oxen::quic
         return nbufs;
     }
 
+    void Stream::pull_from_provider()
+    {
+        log::trace(log_cat, "{} called", __PRETTY_FUNCTION__);
+        assert(_conn);
+
+        size_t budget = std::min<uint64_t>(
+                {ngtcp2_conn_get_max_stream_data_left(*_conn, _stream_id),
+                 ngtcp2_conn_get_max_data_left(*_conn),
+                 ngtcp2_conn_get_cwnd_left(*_conn)});
+
+        if (budget == 0)
+        {
+            log::trace(log_cat, "Stream (ID: {}) data provider blocked by flow control or congestion", _stream_id);
+            return;
+        }
+
+        std::pair<bstring_view, std::shared_ptr<void>> next;
+        std::optional<uint64_t> error;
+        try
+        {
+            next = _provider(*this, budget);
+            if (next.first.size() > budget)
+                throw std::out_of_range{"Stream data provider exceeded its budget ({}B > {}B)"_format(
+                        next.first.size(), budget)};
+        }
+        catch (const application_stream_error& e)
+        {
+            log::debug(log_cat, "Stream {} data provider threw us a custom error code ({})", _stream_id, e.code);
+            error = e.code;
+        }
+        catch (const std::exception& e)
+        {
+            log::warning(log_cat, "Stream {} data provider raised exception ({})", _stream_id, e.what());
+            error = STREAM_ERROR_EXCEPTION;
+        }
+
+        if (error || next.first.empty())
+        {
+            _provider = nullptr;
+
+            // Defer both the close and the `done` callback: we are in the middle of writing packets, so neither one should
+            // be able to touch the stream (or queue more data onto it) until we get back to the event loop.
+            endpoint.call_soon([wself = weak_from_this(), done = std::move(_provider_done), error]() {
+                auto self = wself.lock();
+                if (!self)
+                    return;
+                if (error)
+                    self->close(*error);
+                else if (done)
+                    done(*self);
+            });
+            _provider_done = nullptr;
+            return;
+        }
+
+        auto& [data, keep_alive] = next;
+        log::trace(log_cat, "Stream (ID: {}) data provider produced {}B", _stream_id, data.size());
+        _buffered_size += data.size();
+        user_buffers.emplace_back(data, std::move(keep_alive));
+    }
+
     void Stream::send_impl(bstring_view data, std::shared_ptr<void> keep_alive)
     {
         if (data.empty())
@@ -350,6 +655,28 @@ namespace oxen::quic
         });
     }
 
+    void Stream::send_impl(std::vector<bstring_view> bufs, std::shared_ptr<void> keep_alive)
+    {
+        std::erase_if(bufs, [](const bstring_view& b) { return b.empty(); });
+        if (bufs.empty())
+            return;
+
+        endpoint.call([this, bufs = std::move(bufs), ka = std::move(keep_alive)]() {
+            if (!_conn || _conn->is_closing() || _conn->is_draining())
+            {
+                log::warning(log_cat, "Stream {} unable to send: connection is closed", _stream_id);
+                return;
+            }
+            log::trace(log_cat, "Stream (ID: {}) sending {} buffers", _stream_id, bufs.size());
+            for (size_t i = 0; i < bufs.size() - 1; i++)
+            {
+                user_buffers.emplace_back(bufs[i], ka);
+                _buffered_size += bufs[i].size();
+            }
+            append_buffer(bufs.back(), std::move(ka));
+        });
+    }
+
     size_t Stream::unsent_impl() const
     {
         log::trace(log_cat, "size={}, unacked={}", size(), unacked());
@@ -0,0 +1,163 @@
+#include "stream_slice.hpp"
+
+#include "internal.hpp"
+#include "stream.hpp"
+
+namespace oxen::quic
+{
+    namespace detail
+    {
+        static constexpr size_t align_header(size_t pos)
+        {
+            constexpr size_t a = alignof(slice_header);
+            return (pos + a - 1) / a * a;
+        }
+
+        bool recv_block::fits(size_t size) const
+        {
+            return align_header(used) + sizeof(slice_header) + size <= capacity;
+        }
+
+        slice_header* recv_block::append(bstring_view data, size_t credit)
+        {
+            assert(fits(data.size()));
+            auto hdr_pos = align_header(used);
+            auto* hdr = new (buf.get() + hdr_pos) slice_header{static_cast<uint32_t>(credit), this};
+            std::memcpy(buf.get() + hdr_pos + sizeof(slice_header), data.data(), data.size());
+            used = hdr_pos + sizeof(slice_header) + data.size();
+            refs.fetch_add(1, std::memory_order_relaxed);
+            return hdr;
+        }
+
+        void release_block(recv_block* block)
+        {
+            if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            block->owner.reset();
+            block->used = 0;
+            // Hold the pool alive through the put(), even if this block held the last reference to it
+            auto pool = std::move(block->pool);
+            pool->put(block);
+        }
+
+        recv_block_pool::~recv_block_pool()
+        {
+            for (auto* b : free_blocks)
+                delete b;
+        }
+
+        recv_block* recv_block_pool::get(size_t min_size)
+        {
+            recv_block* block = nullptr;
+            auto needed = align_header(0) + sizeof(slice_header) + min_size;
+            if (needed <= BLOCK_SIZE)
+            {
+                std::lock_guard lock{mut};
+                if (!free_blocks.empty())
+                {
+                    block = free_blocks.back();
+                    free_blocks.pop_back();
+                }
+            }
+            if (!block)
+                block = new recv_block{std::max(needed, BLOCK_SIZE)};
+
+            block->pool = shared_from_this();
+            block->refs.store(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        void recv_block_pool::put(recv_block* block)
+        {
+            if (block->capacity == BLOCK_SIZE)
+            {
+                std::lock_guard lock{mut};
+                if (free_blocks.size() < MAX_FREE)
+                {
+                    free_blocks.push_back(block);
+                    return;
+                }
+            }
+            delete block;
+        }
+
+        size_t recv_block_pool::num_free() const
+        {
+            std::lock_guard lock{mut};
+            return free_blocks.size();
+        }
+    }  // namespace detail
+
+    stream_slice::stream_slice(const stream_slice& s) : hdr{s.hdr}, _data{s._data}, _size{s._size}
+    {
+        if (hdr)
+            hdr->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    stream_slice::stream_slice(stream_slice&& s) noexcept : hdr{s.hdr}, _data{s._data}, _size{s._size}
+    {
+        s.hdr = nullptr;
+        s._data = nullptr;
+        s._size = 0;
+    }
+
+    stream_slice& stream_slice::operator=(const stream_slice& s)
+    {
+        if (this != &s)
+        {
+            if (s.hdr)
+                s.hdr->refs.fetch_add(1, std::memory_order_relaxed);
+            release();
+            hdr = s.hdr;
+            _data = s._data;
+            _size = s._size;
+        }
+        return *this;
+    }
+
+    stream_slice& stream_slice::operator=(stream_slice&& s) noexcept
+    {
+        if (this != &s)
+        {
+            release();
+            hdr = s.hdr;
+            _data = s._data;
+            _size = s._size;
+            s.hdr = nullptr;
+            s._data = nullptr;
+            s._size = 0;
+        }
+        return *this;
+    }
+
+    void stream_slice::release()
+    {
+        if (!hdr)
+            return;
+
+        if (hdr->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            auto* block = hdr->block;
+            if (hdr->credit)
+                if (auto s = block->owner.lock())
+                    s->return_credit(hdr->credit);
+            detail::release_block(block);
+        }
+
+        hdr = nullptr;
+        _data = nullptr;
+        _size = 0;
+    }
+
+    stream_slice stream_slice::substr(size_t pos, size_t count) const
+    {
+        if (pos > _size)
+            throw std::out_of_range{"stream_slice::substr position out of range"};
+        count = std::min(count, _size - pos);
+        if (hdr)
+            hdr->refs.fetch_add(1, std::memory_order_relaxed);
+        return {hdr, _data + pos, count};
+    }
+
+}  // namespace oxen::quic
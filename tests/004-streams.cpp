@@ -1,4 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <map>
 #include <memory>
 #include <oxen/quic.hpp>
 #include <oxen/quic/gnutls_crypto.hpp>
@@ -1086,4 +1088,915 @@ namespace oxen::quic::test
         CHECK(conn->num_streams_pending() == 0);
     }
 
+    TEST_CASE("004 - Scatter-gather stream sending", "[004][streams][scatter]")
+    {
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::string received;
+        const auto expected = "[HEADER]body-part-1|body-part-2|[HEADER2]second body"s;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        stream_data_callback server_data_cb = [&](Stream&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received += to_sv(data);
+            if (received.size() >= expected.size())
+                data_promise.set_value();
+        };
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls, server_data_cb));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn_interface = client_endpoint->connect(client_remote, client_tls);
+
+        auto client_stream = conn_interface->open_stream();
+
+        auto body = std::make_shared<std::string>("body-part-1|body-part-2|");
+        std::array<bstring_view, 4> segments{
+                "[HEADER]"_bsv,
+                convert_sv<std::byte>(std::string_view{*body}.substr(0, 12)),
+                ""_bsv,
+                convert_sv<std::byte>(std::string_view{*body}.substr(12))};
+        client_stream->send(std::span<const bstring_view>{segments}, body);
+        client_stream->send(std::vector<std::string>{"[HEADER2]"s, "second body"s});
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received == expected);
+    }
+
+    TEST_CASE("004 - Retained stream receive mode", "[004][streams][retained]")
+    {
+        Network test_net{};
+
+        // Larger than the initial stream flow control window
+        constexpr size_t window = 6_Mi;
+        constexpr size_t total_size = 8_Mi;
+
+        std::mutex recv_mut;
+        std::vector<stream_slice> held;
+        size_t received = 0;
+        // Set once we let go of the held slices; anything received beyond the window before then is a failure
+        bool released = false;
+        bool over_window = false;
+
+        std::promise<void> window_promise, done_promise;
+        std::future<void> window_future = window_promise.get_future(), done_future = done_promise.get_future();
+
+        stream_open_callback server_open_cb = [&](Stream& s) {
+            s.set_stream_slice_cb([&](Stream&, stream_slice data) {
+                std::lock_guard lock{recv_mut};
+                auto before = received;
+                received += data.size();
+                if (!released && received > window)
+                    over_window = true;
+                // Keep the first byte of every slice alive; this should hold back the flow control credit for the
+                // *entire* slice.
+                held.push_back(data.substr(0, 1));
+                if (before < window && received >= window)
+                    window_promise.set_value();
+                if (received == total_size)
+                    done_promise.set_value();
+            });
+            return 0;
+        };
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls, server_open_cb));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn_interface = client_endpoint->connect(client_remote, client_tls);
+
+        auto client_stream = conn_interface->open_stream();
+
+        bstring payload;
+        payload.resize(total_size);
+        for (size_t i = 0; i < total_size; i++)
+            payload[i] = static_cast<std::byte>(i % 251);
+        client_stream->send(std::move(payload));
+
+        // The initial window's worth arrives, but everything beyond it is stuck until we let go of what we are holding
+        require_future(window_future, 5s);
+        {
+            std::lock_guard lock{recv_mut};
+            REQUIRE(received == window);
+            REQUIRE_FALSE(over_window);
+
+            for (size_t i = 0; i < held.size(); i++)
+                REQUIRE(held[i].size() == 1);
+        }
+
+        // Releasing the slices from outside the event loop returns the credit, letting the rest through
+        {
+            std::vector<stream_slice> release;
+            {
+                std::lock_guard lock{recv_mut};
+                release.swap(held);
+                released = true;
+            }
+        }
+
+        // We keep holding whatever arrives after this, but there's enough credit now for everything
+        require_future(done_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received == total_size);
+        // Nothing beyond the window arrived while the first slices were still held
+        REQUIRE_FALSE(over_window);
+    }
+
+    TEST_CASE("004 - BTRequestStream in-place request parsing", "[004][streams][btreq][retained]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // With opt::bt_parse_in_place, small requests arrive whole and are parsed in place; the large one spans several
+        // chunks of stream data and has to be reassembled.  Either way (and without the option, where everything is
+        // copied) the messages must stay valid after the handler returns.
+        const bool in_place = GENERATE(true, false);
+        constexpr int n_reqs = 20;
+        constexpr int large_req = 10;
+        auto make_body = [](int i) { return i == large_req ? std::string(200_ki, 'L') : "small body {}"_format(i); };
+
+        std::mutex recv_mut;
+        std::vector<message> held;
+        std::promise<void> got_all;
+
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = in_place ? ci.queue_incoming_stream<BTRequestStream>(opt::bt_parse_in_place{})
+                              : ci.queue_incoming_stream<BTRequestStream>();
+            s->register_generic_handler([&](message m) {
+                std::lock_guard lock{recv_mut};
+                held.push_back(std::move(m));
+                if (held.size() == n_reqs)
+                    got_all.set_value();
+            });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        auto client_bt = conn->open_stream<BTRequestStream>();
+        for (int i = 0; i < n_reqs; i++)
+            client_bt->command("req{}"_format(i), make_body(i));
+
+        REQUIRE(server_established.wait());
+        require_future(got_all.get_future());
+
+        std::lock_guard lock{recv_mut};
+        REQUIRE(held.size() == n_reqs);
+        for (int i = 0; i < n_reqs; i++)
+        {
+            CHECK(held[i].type() == message::TYPE_COMMAND);
+            CHECK(held[i].endpoint() == "req{}"_format(i));
+            CHECK(held[i].body() == make_body(i));
+        }
+    }
+
+    TEST_CASE("004 - BTRequestStream zero-copy bodies", "[004][streams][btreq][keepalive]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // Makes a body that signals `released` once the last reference to it (i.e. that of the
+        // stream sending it, once everything has been acknowledged) goes away
+        auto make_body = [](size_t size, char c, std::future<void>& released) {
+            auto p = std::make_shared<std::promise<void>>();
+            released = p->get_future();
+            return std::shared_ptr<std::string>{new std::string(size, c), [p](std::string* b) {
+                                                    delete b;
+                                                    p->set_value();
+                                                }};
+        };
+
+        // The response body is owned by the keep-alive given to respond(), and is never copied
+        std::future<void> response_released, request_released;
+        auto response = make_body(300_ki, 'R', response_released);
+
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = ci.queue_incoming_stream<BTRequestStream>();
+            s->register_handler("fetch", [response = std::move(response)](message m) mutable {
+                REQUIRE(m.body().size() == 100_ki);
+                m.respond(std::string_view{*response}, false, std::move(response));
+            });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        auto request = make_body(100_ki, 'Q', request_released);
+
+        std::promise<message> got_response;
+        auto client_bt = conn->open_stream<BTRequestStream>();
+        client_bt->command(
+                "fetch",
+                std::string_view{*request},
+                [&](message m) { got_response.set_value(std::move(m)); },
+                std::shared_ptr<void>{std::move(request)});
+
+        REQUIRE(server_established.wait());
+        auto fut = got_response.get_future();
+        REQUIRE(fut.wait_for(5s) == std::future_status::ready);
+        auto m = fut.get();
+        REQUIRE(m);
+        CHECK(m.body() == std::string(300_ki, 'R'));
+
+        // Once everything has been acknowledged the streams let go of the bodies
+        require_future(request_released, 5s);
+        require_future(response_released, 5s);
+        CHECK(client_bt->num_pending() == 0);
+    }
+
+    TEST_CASE("004 - BTRequestStream shared endpoint router", "[004][streams][btreq][router]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        std::atomic<int> routed{0};
+        auto router = std::make_shared<const bt_router>(std::vector<std::pair<std::string, bt_router::handler>>{
+                {"ping", [&](message m) {
+                     routed++;
+                     m.respond("pong"sv);
+                 }},
+                {"echo", [&](message m) {
+                     routed++;
+                     m.respond(m.body());
+                 }}});
+        REQUIRE(router->size() == 2);
+        REQUIRE(router->find("ping"));
+        REQUIRE_FALSE(router->find("pin"));
+        REQUIRE_THROWS_AS(
+                bt_router(std::vector<std::pair<std::string, bt_router::handler>>{
+                        {"dupe", [](message) {}}, {"dupe", [](message) {}}}),
+                std::invalid_argument);
+
+        // Every server stream shares the one router; the first also overrides "echo" with its own handler
+        std::atomic<int> n_streams{0};
+        stream_constructor_callback server_constructor =
+                [&](Connection& c, Endpoint& e, std::optional<int64_t>) -> std::shared_ptr<Stream> {
+            auto s = e.make_shared<BTRequestStream>(c, e, router);
+            if (n_streams++ == 0)
+                s->register_handler("echo", [](message m) { m.respond("overridden"sv); });
+            return s;
+        };
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_constructor);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        auto request = [](std::shared_ptr<BTRequestStream>& s, std::string ep, std::string body) {
+            std::promise<std::pair<bool, std::string>> p;
+            auto f = p.get_future();
+            s->command(std::move(ep), body, [&p](message m) { p.set_value({!!m, m.body_str()}); });
+            REQUIRE(f.wait_for(5s) == std::future_status::ready);
+            return f.get();
+        };
+
+        auto s1 = conn->open_stream<BTRequestStream>();
+        auto s2 = conn->open_stream<BTRequestStream>();
+
+        CHECK(request(s1, "ping", "") == std::pair{true, "pong"s});
+        CHECK(request(s1, "echo", "hi") == std::pair{true, "overridden"s});
+        CHECK(request(s2, "ping", "") == std::pair{true, "pong"s});
+        CHECK(request(s2, "echo", "hi") == std::pair{true, "hi"s});
+        CHECK(request(s2, "nope", "") == std::pair{false, "Invalid endpoint 'nope'"s});
+        CHECK(routed == 3);
+    }
+
+    TEST_CASE("004 - BTRequestStream request timeouts fire in deadline order", "[004][streams][btreq][timeout]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // The server never replies
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = ci.queue_incoming_stream<BTRequestStream>();
+            s->register_generic_handler([](message) {});
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+        auto client_bt = conn->open_stream<BTRequestStream>();
+
+        std::mutex mut;
+        std::vector<std::pair<std::string, std::chrono::milliseconds>> timed_out;
+        std::promise<void> short_done, all_done;
+
+        auto started = get_time();
+        auto on_timeout = [&](std::string name) {
+            return [&, name = std::move(name)](message m) {
+                REQUIRE(m.timed_out);
+                std::lock_guard lock{mut};
+                timed_out.emplace_back(
+                        name, std::chrono::duration_cast<std::chrono::milliseconds>(get_time() - started));
+                if (timed_out.size() == 2)
+                    short_done.set_value();
+                else if (timed_out.size() == 3)
+                    all_done.set_value();
+            };
+        };
+
+        // Requests expiring sooner than those issued before them must not wait behind them
+        client_bt->command("slow", ""sv, on_timeout("long"), 1500ms);
+        client_bt->command("slow", ""sv, on_timeout("short"), 100ms);
+        client_bt->command("slow", ""sv, on_timeout("medium"), 200ms);
+
+        REQUIRE(server_established.wait());
+        require_future(short_done.get_future());
+        {
+            std::lock_guard lock{mut};
+            REQUIRE(timed_out.size() == 2);
+            CHECK(timed_out[0].first == "short");
+            CHECK(timed_out[1].first == "medium");
+            CHECK(timed_out[1].second < 1000ms);
+        }
+
+        require_future(all_done.get_future(), 3s);
+        std::lock_guard lock{mut};
+        CHECK(timed_out[2].first == "long");
+        CHECK(timed_out[2].second >= 1500ms);
+    }
+
+    TEST_CASE("004 - BTRequestChannel spreads requests across streams", "[004][streams][btreq][channel]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        constexpr int n_small = 20;
+
+        std::mutex mut;
+        std::set<int64_t> small_streams, small_rids;
+
+        auto bulk_body = std::make_shared<std::string>(4_Mi, 'B');
+        auto router = std::make_shared<const bt_router>(std::vector<std::pair<std::string, bt_router::handler>>{
+                {"small",
+                 [&](message m) {
+                     {
+                         std::lock_guard lock{mut};
+                         small_streams.insert(m.stream()->stream_id());
+                         small_rids.insert(m.rid());
+                     }
+                     m.respond(m.body());
+                 }},
+                {"bulk", [bulk_body](message m) { m.respond(std::string_view{*bulk_body}, false, bulk_body); }}});
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, BTRequestChannel::stream_constructor(router));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        REQUIRE_THROWS_AS(BTRequestChannel(conn, nullptr, 0), std::invalid_argument);
+
+        BTRequestChannel channel{conn, nullptr, 4};
+        REQUIRE(channel.streams().size() == 4);
+
+        std::vector<std::string> done;
+        std::promise<void> all_done, dedicated_closed;
+        auto record = [&](std::string name) {
+            return [&, name = std::move(name)](message m) {
+                REQUIRE(m);
+                if (name == "bulk")
+                {
+                    REQUIRE(m.body().size() == 4_Mi);
+                    // The dedicated stream closes itself once this callback returns
+                    m.stream()->set_stream_close_cb([&](Stream&, uint64_t) { dedicated_closed.set_value(); });
+                }
+                std::lock_guard lock{mut};
+                done.push_back(name);
+                if (done.size() == n_small + 1)
+                    all_done.set_value();
+            };
+        };
+
+        channel.command_dedicated("bulk", ""sv, record("bulk"));
+        for (int i = 0; i < n_small; i++)
+            channel.command("small", "{}"_format(i), record("small"));
+
+        require_future(all_done.get_future(), 10s);
+        {
+            std::lock_guard lock{mut};
+            // Small requests went round-robin over the pool, with request ids unique across streams
+            CHECK(small_streams.size() == 4);
+            CHECK(small_rids.size() == n_small);
+            // ...and were not held up behind the bulk response on its dedicated stream
+            REQUIRE(done.size() == n_small + 1);
+            CHECK(done.back() == "bulk");
+        }
+
+        // The dedicated stream closes itself once its response has arrived
+        require_future(dedicated_closed.get_future(), 5s);
+        CHECK(conn->num_streams_active() == 4);
+    }
+
+    TEST_CASE("004 - BTRequestStream streamed requests and responses", "[004][streams][btreq][chunked]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // Three 4MiB chunks each way: more than MAX_REQ_LEN in total, without either side ever holding
+        // the whole body.
+        constexpr size_t chunk_size = 4_Mi;
+        constexpr int n_chunks = 3;
+        auto chunk = std::make_shared<std::string>(chunk_size, 'x');
+
+        size_t server_received = 0;
+        int server_chunks = 0;
+
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = ci.queue_incoming_stream<BTRequestStream>();
+            s->register_handler("upload", [&](message m) {
+                REQUIRE(m.is_chunk());
+                REQUIRE(m.type() == message::TYPE_COMMAND_CHUNK);
+                server_received += m.body().size();
+                server_chunks++;
+                if (!m.is_last())
+                    return;
+
+                auto w = m.respond_stream();
+                w.write("{}"_format(server_received));
+                for (int i = 0; i < n_chunks; i++)
+                    w.write(std::string_view{*chunk}, chunk);
+                // w's destructor sends the (empty) final chunk
+            });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+        auto client_bt = conn->open_stream<BTRequestStream>();
+
+        std::vector<std::string> first_chunk;
+        size_t client_received = 0;
+        int client_chunks = 0;
+        std::promise<void> done;
+
+        auto w = client_bt->command_stream("upload", [&](message m) {
+            REQUIRE(m);
+            REQUIRE(m.is_chunk());
+            if (client_chunks++ == 0)
+                first_chunk.push_back(m.body_str());
+            else
+                client_received += m.body().size();
+            if (m.is_last())
+                done.set_value();
+        });
+        for (int i = 0; i < n_chunks; i++)
+            w.write(std::string_view{*chunk}, chunk);
+        w.finish();
+        REQUIRE(w.finished());
+        REQUIRE_THROWS_AS(w.write("more"sv), std::logic_error);
+
+        REQUIRE(server_established.wait());
+        require_future(done.get_future(), 10s);
+
+        CHECK(server_chunks == n_chunks + 1);
+        CHECK(server_received == n_chunks * chunk_size);
+        REQUIRE(first_chunk.size() == 1);
+        CHECK(first_chunk[0] == "{}"_format(n_chunks * chunk_size));
+        CHECK(client_chunks == n_chunks + 2);
+        CHECK(client_received == n_chunks * chunk_size);
+    }
+
+    TEST_CASE("004 - BTRequestStream streamed command pacing", "[004][streams][btreq][chunked]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        constexpr size_t chunk_size = 1_Mi;
+        constexpr int n_chunks = 8;
+        auto chunk = std::make_shared<std::string>(chunk_size, 'x');
+
+        size_t server_received = 0;
+
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = ci.queue_incoming_stream<BTRequestStream>();
+            s->register_handler("upload", [&](message m) {
+                server_received += m.body().size();
+                if (m.is_last())
+                    m.respond("{}"_format(server_received));
+            });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+        auto client_bt = conn->open_stream<BTRequestStream>();
+
+        std::promise<std::string> response;
+
+        SECTION("Writer waits for earlier chunks to be delivered")
+        {
+            auto w = std::make_shared<bt_chunk_writer>(client_bt->command_stream("upload", [&](message m) {
+                response.set_value(m ? m.body_str() : "failed");
+            }));
+
+            int written = 0;
+            std::function<void()> write_next = [&] {
+                if (written++ == n_chunks)
+                    return w->finish();
+                w->write(std::string_view{*chunk}, chunk);
+                w->when_writable(write_next, chunk_size);
+            };
+            client_endpoint->call(write_next);
+
+            REQUIRE(server_established.wait());
+            auto f = response.get_future();
+            require_future(f, 10s);
+            CHECK(f.get() == "{}"_format(n_chunks * chunk_size));
+            CHECK(written == n_chunks + 1);
+        }
+
+        SECTION("Timeout starts when the body is finished")
+        {
+            // The upload takes longer than the timeout, which must not count until finish()
+            auto w = client_bt->command_stream(
+                    "upload", [&](message m) { response.set_value(m ? m.body_str() : "failed"); }, 100ms);
+            for (int i = 0; i < 3; i++)
+            {
+                w.write(std::string_view{*chunk}, chunk);
+                std::this_thread::sleep_for(75ms);
+            }
+            w.finish();
+
+            REQUIRE(server_established.wait());
+            auto f = response.get_future();
+            require_future(f, 10s);
+            CHECK(f.get() == "{}"_format(3 * chunk_size));
+        }
+    }
+
+    TEST_CASE("004 - BTRequestStream handlers on a worker pool", "[004][streams][btreq][workers]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto pool = std::make_shared<bt_worker_pool>(4);
+        REQUIRE(pool->size() == 4);
+        REQUIRE_THROWS_AS(bt_worker_pool{0}, std::invalid_argument);
+
+        constexpr int n_streams = 2;
+        constexpr int n_reqs = 5;
+
+        std::atomic<int> running{0}, max_running{0};
+        std::atomic<bool> on_loop{false}, overlapped_on_stream{false};
+        std::mutex mut;
+        std::map<int64_t, std::vector<int>> handled;  // stream id -> request bodies, in handling order
+        std::map<int64_t, bool> stream_busy;
+
+        stream_constructor_callback server_constructor =
+                [&](Connection& c, Endpoint& e, std::optional<int64_t>) -> std::shared_ptr<Stream> {
+            auto s = e.make_shared<BTRequestStream>(c, e, pool);
+            s->register_handler("slow", [&](message m) {
+                auto bs = m.stream();
+                if (bs->endpoint.in_event_loop())
+                    on_loop = true;
+                {
+                    std::lock_guard lock{mut};
+                    if (std::exchange(stream_busy[bs->stream_id()], true))
+                        overlapped_on_stream = true;
+                }
+
+                auto r = ++running;
+                for (int cur = max_running; r > cur && !max_running.compare_exchange_weak(cur, r);)
+                    ;
+                std::this_thread::sleep_for(20ms);
+                --running;
+
+                {
+                    std::lock_guard lock{mut};
+                    handled[bs->stream_id()].push_back(std::stoi(m.body_str()));
+                    stream_busy[bs->stream_id()] = false;
+                }
+                m.respond(m.body());
+            });
+            return s;
+        };
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_constructor);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        std::atomic<int> responses{0};
+        std::promise<void> all_done;
+        std::vector<std::shared_ptr<BTRequestStream>> streams;
+        for (int i = 0; i < n_streams; i++)
+        {
+            auto& s = streams.emplace_back(conn->open_stream<BTRequestStream>());
+            for (int j = 0; j < n_reqs; j++)
+                s->command("slow", "{}"_format(j), [&](message m) {
+                    REQUIRE(m);
+                    if (++responses == n_streams * n_reqs)
+                        all_done.set_value();
+                });
+        }
+
+        require_future(all_done.get_future(), 5s);
+
+        CHECK_FALSE(on_loop);
+        CHECK_FALSE(overlapped_on_stream);
+        // Different streams are handled in parallel
+        CHECK(max_running == n_streams);
+
+        // ...while each stream's requests are handled in order
+        std::lock_guard lock{mut};
+        REQUIRE(handled.size() == n_streams);
+        for (auto& [id, bodies] : handled)
+            CHECK(bodies == std::vector<int>{0, 1, 2, 3, 4});
+    }
+
+    TEST_CASE("004 - BTRequestStream batched and auto-corked commands", "[004][streams][btreq][batch]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // The server corks its responses, so the responses to everything handled in one loop
+        // iteration go out together
+        std::shared_ptr<BTRequestStream> server_bt;
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            server_bt = ci.queue_incoming_stream<BTRequestStream>();
+            server_bt->set_auto_cork(true);
+            server_bt->register_handler("echo", [](message m) { m.respond(m.body()); });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+        auto client_bt = conn->open_stream<BTRequestStream>();
+
+        constexpr int n_batch = 100, n_corked = 100, n_single = 100;
+        std::mutex mut;
+        std::set<std::string> replies;
+        std::promise<void> batch_done, corked_done, all_done;
+        auto on_reply = [&](message m) {
+            REQUIRE(m);
+            std::lock_guard lock{mut};
+            replies.insert(m.body_str());
+            if (replies.size() == n_batch)
+                batch_done.set_value();
+            else if (replies.size() == n_batch + n_corked)
+                corked_done.set_value();
+            else if (replies.size() == n_batch + n_corked + n_single)
+                all_done.set_value();
+        };
+
+        client_bt->batch([&](bt_batch& b) {
+            REQUIRE(b.empty());
+            for (int i = 0; i < n_batch; i++)
+                b.command("echo", "batch {}"_format(i), on_reply);
+            REQUIRE(b.size() == n_batch);
+        });
+        // An empty batch sends nothing
+        client_bt->batch([](bt_batch&) {});
+
+        REQUIRE(server_established.wait());
+        require_future(batch_done.get_future(), 5s);
+
+        // The whole batch went into the stream with a single send, and the server merged the
+        // responses to each packet's worth of requests rather than sending them one at a time
+        CHECK(TestHelper::get_bt_send_count(*client_bt) == 1);
+        CHECK(TestHelper::get_bt_send_count(*server_bt) < n_batch);
+
+        // With auto-corking, commands issued from within the event loop all go out together once
+        // the loop gets around to sending them
+        client_bt->set_auto_cork(true);
+        client_endpoint->call_get([&] {
+            for (int i = 0; i < n_corked; i++)
+                client_bt->command("echo", "corked {}"_format(i), on_reply);
+            CHECK(TestHelper::get_bt_send_count(*client_bt) == 1);
+        });
+        require_future(corked_done.get_future(), 5s);
+        CHECK(TestHelper::get_bt_send_count(*client_bt) == 2);
+
+        // Individual commands from outside the event loop are merged as well (though how many get
+        // merged depends on how far ahead of the event loop we get)
+        for (int i = 0; i < n_single; i++)
+            client_bt->command("echo", "single {}"_format(i), on_reply);
+
+        require_future(all_done.get_future(), 5s);
+        CHECK(TestHelper::get_bt_send_count(*client_bt) <= 2 + n_single);
+
+        std::lock_guard lock{mut};
+        CHECK(replies.count("batch 0"));
+        CHECK(replies.count("batch 99"));
+        CHECK(replies.count("corked 99"));
+        CHECK(replies.count("single 99"));
+    }
+
+    TEST_CASE("004 - BTRequestStream request cancellation", "[004][streams][btreq][cancel]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        // The server holds on to "slow" requests without responding, and notes when they are
+        // cancelled
+        std::mutex mut;
+        std::vector<message> held;
+        std::promise<std::string> cancelled_p, timed_out_p;
+        auto server_established = callback_waiter{[&](connection_interface& ci) {
+            auto s = ci.queue_incoming_stream<BTRequestStream>();
+            s->register_handler("slow", [&](message m) {
+                REQUIRE_FALSE(m.cancelled());
+                auto& p = m.body() == "cancel me" ? cancelled_p : timed_out_p;
+                m.on_cancel([&p, body = m.body_str()] { p.set_value(body); });
+                std::lock_guard lock{mut};
+                held.push_back(std::move(m));
+            });
+            s->register_handler("echo", [](message m) { m.respond(m.body()); });
+        }};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, server_established);
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+        auto client_bt = conn->open_stream<BTRequestStream>(opt::bt_cancel_on_timeout{});
+
+        std::atomic<bool> got_response{false};
+        auto h = client_bt->command("slow", "cancel me"sv, [&](message) { got_response = true; });
+        CHECK(h.request_id() >= 0);
+        h.cancel();
+
+        REQUIRE(server_established.wait());
+        auto cancelled_f = cancelled_p.get_future();
+        require_future(cancelled_f);
+        CHECK(cancelled_f.get() == "cancel me");
+        {
+            std::lock_guard lock{mut};
+            REQUIRE(held.size() == 1);
+            CHECK(held[0].cancelled());
+        }
+
+        // With opt::bt_cancel_on_timeout, requests that time out are cancelled on the remote as well
+        std::promise<void> timeout_cb;
+        client_bt->command("slow", "time out"sv, [&](message m) {
+            CHECK(m.timed_out);
+            timeout_cb.set_value();
+        }, 100ms);
+        require_future(timeout_cb.get_future());
+        auto timed_out_f = timed_out_p.get_future();
+        require_future(timed_out_f);
+        CHECK(timed_out_f.get() == "time out");
+
+        // A late response to the cancelled request is dropped rather than delivered
+        {
+            std::lock_guard lock{mut};
+            held[0].respond("too late"sv);
+        }
+        std::promise<void> echoed;
+        client_bt->command("echo", "ping"sv, [&](message m) {
+            CHECK(m);
+            echoed.set_value();
+        });
+        require_future(echoed.get_future());
+        CHECK_FALSE(got_response);
+
+        // Cancelling an already-finished request is harmless
+        h.cancel();
+        bt_request_handle{}.cancel();
+    }
+
+    TEST_CASE("004 - Stream churn reuses slab memory", "[004][streams][slab]")
+    {
+        Network test_net{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        server_endpoint->listen(server_tls, [&](Stream& s, bstring_view data) {
+            s.send(data);
+            s.close();
+        });
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn = client_endpoint->connect(client_remote, client_tls);
+
+        auto churn = [&](int n) {
+            for (int i = 0; i < n; i++)
+            {
+                std::promise<void> got_reply;
+                auto s = conn->open_stream<Stream>([&](Stream&, bstring_view) { got_reply.set_value(); });
+                s->send("ping"s);
+                require_future(got_reply.get_future());
+                s->close();
+            }
+        };
+
+        // Reads the stats from within the event loop, so that everything the churn left queued there (such as the final
+        // close) has run first
+        auto loop_stats = [&] { return test_net.call_get([&] { return test_net.pool_stats(); }); };
+
+        churn(10);
+        auto before = loop_stats();
+
+        constexpr int n = 50;
+        churn(n);
+        auto after = loop_stats();
+
+        // Every iteration allocates (at least) client and server stream objects and control blocks, which should be
+        // coming from memory freed by the streams of previous iterations.
+        CHECK(after.allocs - before.allocs >= 2 * n);
+        CHECK(after.reused - before.reused >= 2 * n);
+    }
+
 }  // namespace oxen::quic::test
@@ -1,7 +1,13 @@
 #include <catch2/catch_test_macros.hpp>
+#include <fstream>
 #include <iterator>
 #include <thread>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "utils.hpp"
 
 namespace oxen::quic::test
@@ -110,4 +116,188 @@ namespace oxen::quic::test
                     "Goodbye.");
         }
     }
+
+    TEST_CASE("005 - Stream data provider: Execution", "[005][provider][execute]")
+    {
+        Network test_net{};
+
+        constexpr size_t total_size = 4 * 1024 * 1024;
+
+        std::mutex recv_mut;
+        size_t received_size = 0;
+        bool received_ok = true;
+
+        std::promise<void> finished_p;
+        std::future<void> finished_f = finished_p.get_future();
+
+        stream_data_callback server_data_cb = [&](Stream&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            for (auto b : data)
+                received_ok &= static_cast<uint8_t>(b) == static_cast<uint8_t>(received_size++ % 251);
+            if (received_size == total_size)
+                finished_p.set_value();
+        };
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        Address server_local{};
+        Address client_local{};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls, server_data_cb));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn_interface = client_endpoint->connect(client_remote, client_tls);
+
+        auto stream = conn_interface->open_stream();
+
+        size_t produced = 0, max_budget = 0;
+        std::promise<void> done_p;
+        std::future<void> done_f = done_p.get_future();
+
+        SECTION("Library-supplied buffer")
+        {
+            stream->set_data_provider(
+                    [&](Stream&, std::span<std::byte> buf) -> size_t {
+                        max_budget = std::max(max_budget, buf.size());
+                        auto n = std::min(buf.size(), total_size - produced);
+                        for (size_t i = 0; i < n; i++)
+                            buf[i] = static_cast<std::byte>(produced++ % 251);
+                        return n;
+                    },
+                    [&](Stream&) { done_p.set_value(); });
+        }
+        SECTION("Provider-owned views")
+        {
+            stream->set_data_provider(
+                    [&](Stream&, size_t budget) -> std::pair<bstring_view, std::shared_ptr<void>> {
+                        max_budget = std::max(max_budget, budget);
+                        auto n = std::min(budget, total_size - produced);
+                        auto chunk = std::make_shared<bstring>(n, std::byte{0});
+                        for (auto& b : *chunk)
+                            b = static_cast<std::byte>(produced++ % 251);
+                        return {*chunk, std::move(chunk)};
+                    },
+                    [&](Stream&) { done_p.set_value(); });
+        }
+
+        require_future(done_f);
+        require_future(finished_f);
+
+        {
+            std::lock_guard lock{recv_mut};
+            REQUIRE(received_ok);
+            REQUIRE(received_size == total_size);
+        }
+        // Nothing should have been generated beyond what the connection could actually send at once
+        REQUIRE(max_budget < total_size);
+        REQUIRE_FALSE(stream->has_data_provider());
+    }
+
+    TEST_CASE("005 - Stream data provider: Exceeding the budget", "[005][provider][budget]")
+    {
+        Network test_net{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        Address server_local{};
+        Address client_local{};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn_interface = client_endpoint->connect(client_remote, client_tls);
+
+        std::promise<uint64_t> closed_p;
+        auto closed_f = closed_p.get_future();
+        auto stream = conn_interface->open_stream<Stream>(
+                stream_data_callback{}, [&](Stream&, uint64_t error_code) { closed_p.set_value(error_code); });
+
+        // A provider that produces more than it was asked for is rejected rather than sent anyway
+        auto chunk = std::make_shared<bstring>();
+        stream->set_data_provider([&](Stream&, size_t budget) -> std::pair<bstring_view, std::shared_ptr<void>> {
+            chunk->assign(budget + 1, std::byte{'x'});
+            return {*chunk, chunk};
+        });
+
+        require_future(closed_f, 5s);
+        CHECK(closed_f.get() == STREAM_ERROR_EXCEPTION);
+        REQUIRE_FALSE(stream->has_data_provider());
+    }
+
+#ifndef _WIN32
+    TEST_CASE("005 - Stream file sending: Execution", "[005][sendfile][execute]")
+    {
+        Network test_net{};
+
+        constexpr size_t file_size = 3 * 1024 * 1024 + 123, skip_front = 1000, skip_back = 2000;
+        constexpr size_t send_size = file_size - skip_front - skip_back;
+
+        std::string contents;
+        contents.resize(file_size);
+        for (size_t i = 0; i < file_size; i++)
+            contents[i] = static_cast<char>(i % 253);
+
+        auto path = std::filesystem::temp_directory_path() / "libquic-005-send-file.dat";
+        {
+            std::ofstream out{path, std::ios::binary | std::ios::trunc};
+            out.write(contents.data(), contents.size());
+        }
+
+        std::mutex recv_mut;
+        std::string received;
+
+        std::promise<void> finished_p;
+        std::future<void> finished_f = finished_p.get_future();
+
+        stream_data_callback server_data_cb = [&](Stream&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.append(reinterpret_cast<const char*>(data.data()), data.size());
+            if (received.size() == send_size)
+                finished_p.set_value();
+        };
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        Address server_local{};
+        Address client_local{};
+
+        auto server_endpoint = test_net.endpoint(server_local);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls, server_data_cb));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client_endpoint = test_net.endpoint(client_local);
+        auto conn_interface = client_endpoint->connect(client_remote, client_tls);
+
+        auto stream = conn_interface->open_stream();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        REQUIRE(fd >= 0);
+
+        REQUIRE_THROWS(stream->send_file(fd, skip_front, file_size));
+
+        std::promise<void> done_p;
+        std::future<void> done_f = done_p.get_future();
+
+        // Use a small window so that the transfer spans several separate mappings
+        stream->send_file(fd, skip_front, send_size, [&](Stream&) { done_p.set_value(); }, 1_Mi);
+        ::close(fd);
+
+        require_future(done_f);
+        require_future(finished_f);
+
+        {
+            std::lock_guard lock{recv_mut};
+            REQUIRE(received == contents.substr(skip_front, send_size));
+        }
+
+        std::filesystem::remove(path);
+    }
+#endif
 }  // namespace oxen::quic::test
@@ -158,7 +158,8 @@ namespace oxen::quic::test
             std::promise<void> data_promise;
             std::future<void> data_future = data_promise.get_future();
 
-            dgram_data_callback recv_dgram_cb = [&](dgram_interface&, bstring) {
+            // Deliberately a bare lambda: as an option it must still unambiguously mean a dgram_data_callback
+            auto recv_dgram_cb = [&](dgram_interface&, bstring) {
                 log::debug(log_cat, "Calling endpoint receive datagram callback... data received...");
 
                 data_promise.set_value();
@@ -279,6 +280,609 @@ namespace oxen::quic::test
         }
     }
 
+    TEST_CASE("007 - Datagram support: View callback", "[007][datagrams][execute][split][view]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (data == "final"_bsv)
+                data_promise.set_value();
+        };
+
+        opt::enable_datagrams split_dgram{Splitting::ACTIVE};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local, split_dgram, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, split_dgram, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+        std::this_thread::sleep_for(5ms);
+        auto max_size = conn_interface->get_max_datagram_size();
+
+        // The first is small enough to be sent unsplit; the second has to be split and reassembled
+        std::string small_msg{}, split_msg{};
+        char v = 0;
+        while (small_msg.size() < 100)
+            small_msg += v++;
+        while (split_msg.size() < max_size)
+            split_msg += v++;
+
+        conn_interface->send_datagram(std::string{small_msg});
+        conn_interface->send_datagram(std::string{split_msg});
+        conn_interface->send_datagram("final"s);
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received.size() == 3);
+        CHECK(received[0] == small_msg);
+        CHECK(received[1] == split_msg);
+        CHECK(received[2] == "final");
+    }
+
+    TEST_CASE("007 - Datagram support: Batched sending", "[007][datagrams][execute][batch]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (data == "final"_bsv)
+                data_promise.set_value();
+        };
+
+        opt::enable_datagrams default_gram{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local, default_gram, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, default_gram, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        // The oversized one in the middle gets dropped without affecting the rest of the batch
+        std::string too_big(conn_interface->get_max_datagram_size() + 1, 'x');
+        conn_interface->send_datagrams(std::vector<std::string>{"one"s, "two"s, std::move(too_big), "three"s});
+
+        std::array<bstring_view, 2> views{"four"_bsv, "final"_bsv};
+        conn_interface->send_datagrams(views);
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received == std::vector<std::string>{"one"s, "two"s, "three"s, "four"s, "final"s});
+    }
+
+    TEST_CASE("007 - Datagram support: Bounded send queue", "[007][datagrams][execute][queue]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (data == "final"_bsv)
+                data_promise.set_value();
+        };
+
+        opt::datagram_queue queue_limits;
+        std::vector<std::string> expected;
+        uint64_t expect_dropped = 0, expect_expired = 0;
+
+        std::vector<std::string> batch;
+        for (int i = 0; i < 20; i++)
+            batch.push_back("dgram-{}"_format(i));
+
+        SECTION("Drop newest")
+        {
+            queue_limits = opt::datagram_queue{5, 0, 0ms, opt::datagram_queue::drop::NEWEST};
+            expected.assign(batch.begin(), batch.begin() + 5);
+            expect_dropped = 15;
+        }
+        SECTION("Drop oldest")
+        {
+            queue_limits = opt::datagram_queue{5};
+            expected.assign(batch.end() - 5, batch.end());
+            expect_dropped = 15;
+        }
+        SECTION("Byte limit")
+        {
+            // "dgram-N" is 7 bytes, "dgram-NN" is 8; the last four add up to 32
+            queue_limits = opt::datagram_queue{0, 35};
+            expected.assign(batch.end() - 4, batch.end());
+            expect_dropped = 16;
+        }
+        SECTION("Datagram larger than the byte limit")
+        {
+            // The oversized datagram is discarded without evicting the ones queued before it
+            queue_limits = opt::datagram_queue{0, 35};
+            batch.resize(4);
+            expected = batch;
+            batch.push_back(std::string(40, 'x'));
+            expect_dropped = 1;
+        }
+        SECTION("Expiry")
+        {
+            queue_limits = opt::datagram_queue{0, 0, 5ms};
+            expect_expired = batch.size();
+        }
+        const auto n_batch = batch.size();
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        opt::enable_datagrams default_gram{};
+
+        auto server_endpoint = test_net.endpoint(server_local, default_gram, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, default_gram, queue_limits, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        // Queue everything from inside the event loop so that nothing can be sent until we are done
+        auto stats = client->call_get([&] {
+            conn_interface->send_datagrams(std::move(batch));
+            auto stats = conn_interface->get_datagram_queue_stats();
+            if (expect_expired)
+                std::this_thread::sleep_for(10ms);
+            return stats;
+        });
+
+        CHECK(stats.queued == n_batch - expect_dropped);
+        CHECK(stats.dropped == expect_dropped);
+
+        conn_interface->send_datagram("final"s);
+        require_future(data_future);
+
+        stats = conn_interface->get_datagram_queue_stats();
+        CHECK(stats.queued == 0);
+        CHECK(stats.queued_bytes == 0);
+        CHECK(stats.dropped == expect_dropped);
+        CHECK(stats.expired == expect_expired);
+
+        expected.push_back("final");
+        std::lock_guard lock{recv_mut};
+        CHECK(received == expected);
+    }
+
+    TEST_CASE("007 - Datagram support: Delivery callback", "[007][datagrams][execute][delivery]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        constexpr int n = 10;
+        std::atomic<uint64_t> acked{0}, lost{0};
+        std::promise<void> acked_promise;
+        std::future<void> acked_future = acked_promise.get_future();
+
+        dgram_delivery_callback delivery_cb = [&](dgram_interface&, uint64_t a, uint64_t l) {
+            lost += l;
+            if ((acked += a) == n)
+                acked_promise.set_value();
+        };
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view) {};
+
+        opt::enable_datagrams default_gram{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(server_local, default_gram, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, default_gram, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls, delivery_cb);
+
+        REQUIRE(client_established.wait());
+
+        for (int i = 0; i < n; i++)
+            conn_interface->send_datagram("dgram-{}"_format(i));
+
+        require_future(acked_future);
+        CHECK(acked == n);
+        CHECK(lost == 0);
+    }
+
+    TEST_CASE("007 - Datagram support: Multi-fragment datagrams", "[007][datagrams][execute][split][fragments]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (data == "final"_bsv)
+                data_promise.set_value();
+        };
+
+        opt::enable_datagrams split_dgram{Splitting::ACTIVE};
+        opt::datagram_fragments fragments{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint =
+                test_net.endpoint(server_local, split_dgram, fragments, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, split_dgram, fragments, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        auto max_size = conn_interface->get_max_datagram_size();
+        REQUIRE(max_size >= 9000);
+
+        std::string jumbo(9000, '\0'), largest(max_size, '\0'), too_big(max_size + 1, 'x');
+        for (size_t i = 0; i < jumbo.size(); i++)
+            jumbo[i] = static_cast<char>(i % 251);
+        for (size_t i = 0; i < largest.size(); i++)
+            largest[i] = static_cast<char>(i % 241);
+
+        conn_interface->send_datagram(std::string{jumbo});
+        conn_interface->send_datagram(std::string{largest});
+        conn_interface->send_datagram(std::move(too_big));
+        conn_interface->send_datagram("final"s);
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received.size() == 3);
+        CHECK(received[0] == jumbo);
+        CHECK(received[1] == largest);
+        CHECK(received[2] == "final");
+    }
+
+    TEST_CASE(
+            "007 - Datagram support: Oversized datagrams with fragmentation enabled",
+            "[007][datagrams][execute][split][fragments][oversized]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (data == "final"_bsv)
+                data_promise.set_value();
+        };
+
+        opt::enable_datagrams split_dgram{Splitting::ACTIVE};
+        opt::datagram_fragments fragments{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint =
+                test_net.endpoint(server_local, split_dgram, fragments, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, split_dgram, fragments, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        // Sizes between one and two packets' worth go out as (two-part) oversized datagrams rather than as fragments,
+        // and must not hold up anything queued behind them.
+        auto unit = conn_interface->get_max_datagram_size() / fragments.max_fragments;
+        std::vector<std::string> sent;
+        for (auto size : {unit + 2, unit + unit / 2, 2 * unit})
+        {
+            auto& d = sent.emplace_back(size, '\0');
+            for (size_t i = 0; i < d.size(); i++)
+                d[i] = static_cast<char>(i % 239);
+            conn_interface->send_datagram(std::string{d});
+        }
+        conn_interface->send_datagram("final"s);
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received.size() == 4);
+        for (size_t i = 0; i < sent.size(); i++)
+            CHECK(received[i] == sent[i]);
+        CHECK(received[3] == "final");
+    }
+
+    TEST_CASE("007 - Datagram support: Flows", "[007][datagrams][execute][flows]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        auto recorder = [&](std::string_view prefix) {
+            return [&, prefix](dgram_interface&, bstring_view data) {
+                std::lock_guard lock{recv_mut};
+                received.push_back("{}:{}"_format(prefix, to_sv(data)));
+                if (received.size() == 6)
+                    data_promise.set_value();
+            };
+        };
+
+        dgram_view_callback recv_dgram_cb = recorder("default");
+
+        // The server sets up its flows as soon as the connection is established
+        connection_established_callback server_established = [&](connection_interface& ci) {
+            ci.register_datagram_flow(1, recorder("one"));
+            ci.register_datagram_flow(2, recorder("two"));
+            ci.register_datagram_flow(3, recorder("high"));
+            ci.register_datagram_flow(4, recorder("low"));
+        };
+
+        opt::enable_datagrams default_gram{};
+        opt::datagram_flows flows{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(
+                server_local, default_gram, flows, opt::dgram_views{recv_dgram_cb}, server_established);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, default_gram, flows, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        dgram_view_callback ignore = [](dgram_interface&, bstring_view) {};
+        CHECK_THROWS_AS(conn_interface->register_datagram_flow(0, ignore), std::invalid_argument);
+        CHECK_THROWS_AS(conn_interface->register_datagram_flow(flows.max_flows, ignore), std::out_of_range);
+        CHECK_THROWS_AS(conn_interface->send_flow_datagram(flows.max_flows, "x"sv), std::out_of_range);
+
+        conn_interface->register_datagram_flow(3, ignore, 10);
+        conn_interface->register_datagram_flow(4, ignore, -1);
+        CHECK_THROWS_AS(conn_interface->register_datagram_flow(4, ignore), std::invalid_argument);
+
+        client->call_get([&] {
+            conn_interface->send_datagram("a"sv);
+            conn_interface->send_flow_datagram(1, "b"sv);
+            conn_interface->send_flow_datagram(2, "c"sv);
+            // Not registered by the server, so dropped on arrival
+            conn_interface->send_flow_datagram(5, "d"sv);
+            // Queued all at once, these go out in priority order
+            conn_interface->send_flow_datagram(4, "e"sv);
+            conn_interface->send_flow_datagram(3, "f"sv);
+            conn_interface->send_datagram("final"sv);
+        });
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        REQUIRE(received ==
+                std::vector<std::string>{"high:f"s, "default:a"s, "one:b"s, "two:c"s, "default:final"s, "low:e"s});
+    }
+
+    TEST_CASE("007 - Datagram support: Flows with split datagrams", "[007][datagrams][execute][flows][split]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::pair<std::string, std::string>> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        auto recorder = [&](std::string name) {
+            return [&, name](dgram_interface&, bstring_view data) {
+                std::lock_guard lock{recv_mut};
+                received.emplace_back(name, to_sv(data));
+                if (data == "final"_bsv)
+                    data_promise.set_value();
+            };
+        };
+
+        dgram_view_callback recv_dgram_cb = recorder("default");
+
+        // Flow 100 needs a 2-byte flow ID
+        connection_established_callback server_established = [&](connection_interface& ci) {
+            ci.register_datagram_flow(1, recorder("one"));
+            ci.register_datagram_flow(100, recorder("hundred"));
+        };
+
+        opt::enable_datagrams split_dgram{Splitting::ACTIVE};
+        opt::datagram_fragments fragments{};
+        opt::datagram_flows flows{128};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        auto server_endpoint = test_net.endpoint(
+                server_local, split_dgram, fragments, flows, opt::dgram_views{recv_dgram_cb}, server_established);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, split_dgram, fragments, flows, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        // Whole, split, and fragmented datagrams all carry their flow ID in front of the first piece
+        size_t max_size = conn_interface->get_max_datagram_size();
+        size_t unit = max_size / fragments.max_fragments;
+        std::vector<std::pair<std::string, std::string>> sent;
+        for (size_t size : {size_t{10}, unit + unit / 2, 3 * unit, max_size})
+        {
+            std::string d(size, '\0');
+            for (size_t i = 0; i < d.size(); i++)
+                d[i] = static_cast<char>(i % 233);
+            conn_interface->send_flow_datagram(1, std::string{d});
+            sent.emplace_back("one", d);
+            conn_interface->send_flow_datagram(100, std::string{d});
+            sent.emplace_back("hundred", std::move(d));
+        }
+        conn_interface->send_datagram("final"s);
+        sent.emplace_back("default", "final");
+
+        require_future(data_future);
+        std::lock_guard lock{recv_mut};
+        CHECK(received == sent);
+    }
+
+    TEST_CASE("007 - Datagram support: Stream fallback", "[007][datagrams][execute][fallback]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::mutex recv_mut;
+        std::vector<std::string> received;
+
+        std::promise<void> data_promise;
+        std::future<void> data_future = data_promise.get_future();
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace_back(to_sv(data));
+            if (received.size() == 3)
+                data_promise.set_value();
+        };
+
+        opt::enable_datagrams default_gram{};
+        opt::datagram_fallback fallback{};
+
+        Address server_local{};
+        Address client_local{};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        std::shared_ptr<Endpoint> server_endpoint;
+        uint64_t expect_via_stream = 0;
+        std::vector<dgram_transport> expect_transports;
+
+        SECTION("Remote without datagram support")
+        {
+            server_endpoint = test_net.endpoint(server_local, fallback, opt::dgram_views{recv_dgram_cb});
+            expect_via_stream = 3;
+            expect_transports = {dgram_transport::stream, dgram_transport::stream, dgram_transport::stream};
+        }
+        SECTION("Oversized datagrams only")
+        {
+            server_endpoint = test_net.endpoint(server_local, default_gram, fallback, opt::dgram_views{recv_dgram_cb});
+            expect_via_stream = 1;
+            expect_transports = {dgram_transport::datagram, dgram_transport::stream, dgram_transport::datagram};
+        }
+
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        RemoteAddress client_remote{defaults::SERVER_PUBKEY, "127.0.0.1"s, server_endpoint->local().port()};
+
+        auto client = test_net.endpoint(client_local, default_gram, fallback, client_established);
+        auto conn_interface = client->connect(client_remote, client_tls);
+
+        REQUIRE(client_established.wait());
+
+        std::string big(conn_interface->get_max_datagram_size() + 100, 'x');
+
+        std::vector<dgram_transport> transports;
+        auto send = [&](std::string_view data) {
+            conn_interface->send_datagram(convert_sv<std::byte>(data), nullptr, [&](dgram_transport t) {
+                std::lock_guard lock{recv_mut};
+                transports.push_back(t);
+            });
+        };
+        send("one"sv);
+        send(big);
+        send("three"sv);
+
+        require_future(data_future);
+        {
+            std::lock_guard lock{recv_mut};
+            REQUIRE(received.size() == 3);
+            CHECK(std::count(received.begin(), received.end(), "one"s) == 1);
+            CHECK(std::count(received.begin(), received.end(), big) == 1);
+            CHECK(std::count(received.begin(), received.end(), "three"s) == 1);
+            CHECK(transports == expect_transports);
+        }
+
+        CHECK(conn_interface->get_datagram_queue_stats().via_stream == expect_via_stream);
+    }
+
     TEST_CASE(
             "007 - Datagram support: Rotating Buffer, Clearing Buffer", "[007][datagrams][execute][split][rotating][clear]")
     {
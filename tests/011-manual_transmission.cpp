@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <oxen/quic.hpp>
 #include <oxen/quic/gnutls_crypto.hpp>
+#include <set>
 #include <thread>
 
 #include "utils.hpp"
@@ -131,4 +132,297 @@ namespace oxen::quic::test
         CHECK(manual_client_established.wait());
         CHECK(manual_server_established.wait());
     }
+
+    /** Datagram FEC under loss:
+        Sends a run of datagrams between two manually routed endpoints that drop every 10th packet sent by the client,
+        with and without datagram FEC, and compares the fraction of datagrams that make it to the server.
+    */
+    TEST_CASE("011 - Manual Transmission: Datagram FEC under loss", "[011][manual][datagram][fec]")
+    {
+        constexpr size_t num_dgrams = 200;
+        constexpr size_t drop_every = 10;
+
+        auto delivery_rate = [&](opt::enable_datagrams dgram_opt) {
+            auto client_established = callback_waiter{[](connection_interface&) {}};
+            auto server_established = callback_waiter{[](connection_interface&) {}};
+
+            Network test_net{};
+
+            std::shared_ptr<Endpoint> client_endpoint, server_endpoint;
+            Address server_local{}, client_local{};
+
+            std::atomic<bool> lossy{false};
+            std::atomic<size_t> sent_packets{0}, dropped_packets{0}, received{0};
+
+            opt::manual_routing client_sender{[&](const Path& p, bstring_view d) {
+                if (lossy && ++sent_packets % drop_every == 0)
+                {
+                    dropped_packets++;
+                    return;
+                }
+                server_endpoint->manually_receive_packet(Packet{p.invert(), d});
+            }};
+
+            opt::manual_routing server_sender{[&](const Path& p, bstring_view d) {
+                client_endpoint->manually_receive_packet(Packet{p.invert(), d});
+            }};
+
+            dgram_data_callback recv_dgram_cb = [&](dgram_interface&, bstring) { received++; };
+
+            auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+            server_endpoint = test_net.endpoint(server_local, server_sender, server_established, dgram_opt, recv_dgram_cb);
+            REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+            client_endpoint = test_net.endpoint(client_local, client_sender, client_established, dgram_opt);
+            auto conn_interface = client_endpoint->connect(RemoteAddress{defaults::SERVER_PUBKEY, server_local}, client_tls);
+
+            REQUIRE(client_established.wait());
+            REQUIRE(server_established.wait());
+
+            // Large enough that each datagram goes in its own packet
+            const std::string msg(800, 'x');
+            REQUIRE(conn_interface->get_max_datagram_size() >= msg.size());
+
+            lossy = true;
+            for (size_t i = 0; i < num_dgrams; i++)
+                conn_interface->send_datagram(std::string_view{msg});
+
+            // Wait for delivery to finish (i.e. for the received count to stop changing)
+            for (size_t last = 0, stable = 0; stable < 5;)
+            {
+                std::this_thread::sleep_for(50ms);
+                auto now = received.load();
+                stable = now == last ? stable + 1 : 0;
+                last = now;
+            }
+
+            CHECK(dropped_packets > 0);
+
+            return static_cast<double>(received) / num_dgrams;
+        };
+
+        auto plain_rate = delivery_rate(opt::enable_datagrams{});
+        auto fec_rate = delivery_rate(opt::enable_datagrams{opt::enable_datagrams::fec{4}});
+
+        INFO("delivery rate without FEC: " << plain_rate << ", with FEC: " << fec_rate);
+        CHECK(plain_rate < 1.0);
+        CHECK(fec_rate > plain_rate);
+        // With one packet in 10 lost and one parity datagram per 4 datagrams, every loss is recoverable
+        CHECK(fec_rate == 1.0);
+    }
+
+    /** Datagram FEC for a partial block:
+        Sends half a block's worth of datagrams and drops the first of them; the parity sent once the send queue drains
+        should let the receiver rebuild it without waiting for the block to fill up.
+    */
+    TEST_CASE("011 - Manual Transmission: Datagram FEC protects partial blocks", "[011][manual][datagram][fec]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+        auto server_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        std::shared_ptr<Endpoint> client_endpoint, server_endpoint;
+        Address server_local{}, client_local{};
+
+        const std::string msg(800, 'x');
+
+        std::atomic<bool> lossy{false}, dropped{false};
+        opt::manual_routing client_sender{[&](const Path& p, bstring_view d) {
+            // Drop the first packet big enough to be carrying one of our datagrams
+            if (lossy && d.size() >= msg.size() && !dropped.exchange(true))
+                return;
+            server_endpoint->manually_receive_packet(Packet{p.invert(), d});
+        }};
+
+        opt::manual_routing server_sender{[&](const Path& p, bstring_view d) {
+            client_endpoint->manually_receive_packet(Packet{p.invert(), d});
+        }};
+
+        std::mutex recv_mut;
+        std::set<std::string> received;
+        std::promise<void> all_received;
+        dgram_data_callback recv_dgram_cb = [&](dgram_interface&, bstring data) {
+            std::lock_guard lock{recv_mut};
+            received.emplace(to_sv(bstring_view{data}));
+            if (received.size() == 4)
+                all_received.set_value();
+        };
+
+        opt::enable_datagrams dgram_opt{opt::enable_datagrams::fec{8}};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        server_endpoint = test_net.endpoint(server_local, server_sender, server_established, dgram_opt, recv_dgram_cb);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        client_endpoint = test_net.endpoint(client_local, client_sender, client_established, dgram_opt);
+        auto conn_interface = client_endpoint->connect(RemoteAddress{defaults::SERVER_PUBKEY, server_local}, client_tls);
+
+        REQUIRE(client_established.wait());
+        REQUIRE(server_established.wait());
+
+        lossy = true;
+        client_endpoint->call_get([&] {
+            for (char c : {'a', 'b', 'c', 'd'})
+            {
+                auto d = msg;
+                d[0] = c;
+                conn_interface->send_datagram(std::move(d));
+            }
+        });
+
+        require_future(all_received.get_future());
+        CHECK(dropped);
+    }
+
+    /** Datagram FEC at a low send rate:
+        Sends datagrams one at a time, waiting for each to arrive before sending the next, so that the send queue drains
+        after every one of them.  Partial blocks should only be cut short once they are half full, so this still only
+        costs one parity datagram per half block.
+    */
+    TEST_CASE("011 - Manual Transmission: Datagram FEC overhead at a low send rate", "[011][manual][datagram][fec]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+        auto server_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        constexpr int block_size = 8;
+        constexpr int num_dgrams = 32;
+
+        std::shared_ptr<Endpoint> client_endpoint, server_endpoint;
+        Address server_local{}, client_local{};
+
+        opt::manual_routing client_sender{[&](const Path& p, bstring_view d) {
+            server_endpoint->manually_receive_packet(Packet{p.invert(), d});
+        }};
+        opt::manual_routing server_sender{[&](const Path& p, bstring_view d) {
+            client_endpoint->manually_receive_packet(Packet{p.invert(), d});
+        }};
+
+        std::atomic<int> received{0};
+        std::optional<std::promise<void>> got_one;
+        std::mutex recv_mut;
+        dgram_data_callback recv_dgram_cb = [&](dgram_interface&, bstring) {
+            received++;
+            std::lock_guard lock{recv_mut};
+            got_one->set_value();
+        };
+
+        opt::enable_datagrams dgram_opt{opt::enable_datagrams::fec{block_size}};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        server_endpoint = test_net.endpoint(server_local, server_sender, server_established, dgram_opt, recv_dgram_cb);
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        client_endpoint = test_net.endpoint(client_local, client_sender, client_established, dgram_opt);
+        auto conn_interface = client_endpoint->connect(RemoteAddress{defaults::SERVER_PUBKEY, server_local}, client_tls);
+
+        REQUIRE(client_established.wait());
+        REQUIRE(server_established.wait());
+
+        for (int i = 0; i < num_dgrams; i++)
+        {
+            std::future<void> f;
+            {
+                std::lock_guard lock{recv_mut};
+                f = got_one.emplace().get_future();
+            }
+            conn_interface->send_datagram("datagram {}"_format(i));
+            require_future(f);
+        }
+
+        CHECK(received == num_dgrams);
+        auto parity = conn_interface->get_datagram_queue_stats().fec_parity;
+        CHECK(parity > 0);
+        CHECK(parity <= num_dgrams / (block_size / 2));
+    }
+
+    /** Adaptive reassembly window:
+        Holds back one packet carrying half of a split datagram until a few dozen more packets have gone through,
+        which should make the receiver's adaptive reassembly window grow to accommodate that reorder distance.
+    */
+    TEST_CASE("011 - Manual Transmission: Adaptive datagram reassembly window", "[011][manual][datagram][split]")
+    {
+        auto client_established = callback_waiter{[](connection_interface&) {}};
+        auto server_established = callback_waiter{[](connection_interface&) {}};
+
+        Network test_net{};
+
+        constexpr int num_dgrams = 100;
+        constexpr int hold_for = 40;
+
+        std::shared_ptr<Endpoint> client_endpoint, server_endpoint;
+        Address server_local{}, client_local{};
+
+        std::atomic<bool> reorder{false};
+        std::optional<Packet> held;
+        int held_for = 0;
+        std::atomic<int> received{0};
+
+        opt::manual_routing client_sender{[&](const Path& p, bstring_view d) {
+            if (reorder && !held && d.size() > 500)
+            {
+                held.emplace(p.invert(), bstring{d});
+                return;
+            }
+            server_endpoint->manually_receive_packet(Packet{p.invert(), d});
+            if (held && ++held_for == hold_for)
+            {
+                server_endpoint->manually_receive_packet(std::move(*held));
+                reorder = false;
+            }
+        }};
+
+        opt::manual_routing server_sender{[&](const Path& p, bstring_view d) {
+            client_endpoint->manually_receive_packet(Packet{p.invert(), d});
+        }};
+
+        dgram_view_callback recv_dgram_cb = [&](dgram_interface&, bstring_view) { received++; };
+
+        opt::enable_datagrams split_dgram{Splitting::ACTIVE};
+        opt::adaptive_datagram_buffer adaptive{16, 1024};
+
+        auto [client_tls, server_tls] = defaults::tls_creds_from_ed_keys();
+
+        server_endpoint = test_net.endpoint(
+                server_local, server_sender, server_established, split_dgram, adaptive, opt::dgram_views{recv_dgram_cb});
+        REQUIRE_NOTHROW(server_endpoint->listen(server_tls));
+
+        client_endpoint = test_net.endpoint(client_local, client_sender, client_established, split_dgram);
+        auto conn_interface = client_endpoint->connect(RemoteAddress{defaults::SERVER_PUBKEY, server_local}, client_tls);
+
+        REQUIRE(client_established.wait());
+        REQUIRE(server_established.wait());
+
+        auto server_ci = server_endpoint->get_all_conns(Direction::INBOUND).front();
+        REQUIRE(server_ci->get_datagram_reassembly_stats().window == 16);
+
+        // Big enough to be split into two packet-sized halves
+        const std::string msg(conn_interface->get_max_datagram_size() * 3 / 4, 'x');
+
+        reorder = true;
+        for (int i = 0; i < num_dgrams; i++)
+            conn_interface->send_datagram(std::string_view{msg});
+
+        for (int last = 0, stable = 0; stable < 5;)
+        {
+            std::this_thread::sleep_for(50ms);
+            int now = received.load();
+            stable = now == last ? stable + 1 : 0;
+            last = now;
+        }
+
+        auto stats = server_ci->get_datagram_reassembly_stats();
+        CHECK(stats.max_reorder_depth >= hold_for / 4);
+        CHECK(stats.resized > 0);
+        CHECK(stats.window > 16);
+        CHECK(stats.window <= 1024);
+        // The held back half (at most) didn't make it in time to be paired
+        CHECK(received >= num_dgrams - 1);
+        CHECK(stats.paired == static_cast<uint64_t>(received.load()));
+    }
 }  //  namespace oxen::quic::test
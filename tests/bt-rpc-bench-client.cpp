@@ -0,0 +1,217 @@
+/*
+    BT RPC benchmark client: keeps a fixed number of BTRequestStream commands in flight against a
+    bt-rpc-bench-server and reports the round-trip time distribution and request rate.
+*/
+
+#include <oxenc/endian.h>
+
+#include <CLI/Validators.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <oxen/quic.hpp>
+#include <oxen/quic/gnutls_crypto.hpp>
+#include <thread>
+
+#include "utils.hpp"
+
+using namespace oxen::quic;
+
+int main(int argc, char* argv[])
+{
+    CLI::App cli{"libQUIC BT RPC benchmark client"};
+
+    std::string remote_addr = "127.0.0.1:5500";
+    cli.add_option("--remote", remote_addr, "Remote address to connect to")->type_name("IP:PORT")->capture_default_str();
+
+    std::string remote_pubkey;
+    cli.add_option("-p,--remote-pubkey", remote_pubkey, "Remote bt-rpc-bench-server pubkey")
+            ->type_name("PUBKEY_HEX_OR_B64")
+            ->transform([](const std::string& val) -> std::string {
+                if (auto pk = decode_bytes(val))
+                    return std::move(*pk);
+                throw CLI::ValidationError{
+                        "Invalid value passed to --remote-pubkey: expected value encoded as hex or base64"};
+            })
+            ->required();
+
+    std::string local_addr = "";
+    cli.add_option("--local", local_addr, "Local bind address, if required")->type_name("IP:PORT")->capture_default_str();
+
+    std::string log_file, log_level;
+    add_log_opts(cli, log_file, log_level);
+
+    size_t num_conns = 1;
+    cli.add_option("-c,--connections", num_conns, "Number of connections to the server")
+            ->check(CLI::Range(1, 256))
+            ->capture_default_str();
+
+    size_t num_streams = 1;
+    cli.add_option("-s,--streams", num_streams, "Number of BTRequestStreams to open on each connection")
+            ->check(CLI::Range(1, 64))
+            ->capture_default_str();
+
+    size_t concurrency = 1;
+    cli.add_option(
+               "-j,--concurrency",
+               concurrency,
+               "Number of requests to keep in flight on each connection (spread across its streams)")
+            ->check(CLI::Range(1, 10'000))
+            ->capture_default_str();
+
+    uint64_t num_requests = 100'000;
+    cli.add_option("-n,--requests", num_requests, "Total number of requests to time, across all connections")
+            ->capture_default_str();
+
+    uint64_t warmup = 1'000;
+    cli.add_option("--warmup", warmup, "Number of untimed requests to make before the timed run")->capture_default_str();
+
+    size_t req_size = 32;
+    cli.add_option("-S,--size", req_size, "Size of each request body")->capture_default_str();
+
+    std::optional<size_t> resp_size;
+    cli.add_option(
+            "-R,--response-size",
+            resp_size,
+            "Size of each response body; if omitted the server echoes the request body back.  Requests are at least 8 "
+            "bytes when this is given.");
+
+    try
+    {
+        cli.parse(argc, argv);
+    }
+    catch (const CLI::ParseError& e)
+    {
+        return cli.exit(e);
+    }
+
+    setup_logging(log_file, log_level);
+
+    std::string endpoint = resp_size ? "sized" : "echo";
+    std::string body(resp_size ? std::max(req_size, sizeof(uint64_t)) : req_size, 'q');
+    if (resp_size)
+        oxenc::write_host_as_little(static_cast<uint64_t>(*resp_size), body.data());
+
+    Network client_net{};
+
+    auto [seed, pubkey] = generate_ed25519();
+    auto client_tls = GNUTLSCreds::make_from_ed_keys(seed, pubkey);
+
+    Address client_local{};
+    if (!local_addr.empty())
+    {
+        auto [a, p] = parse_addr(local_addr);
+        client_local = Address{a, p};
+    }
+
+    auto [server_a, server_p] = parse_addr(remote_addr);
+    RemoteAddress server_addr{remote_pubkey, server_a, server_p};
+
+    log::debug(test_cat, "Constructing endpoint on {}", client_local);
+    auto client = client_net.endpoint(client_local);
+
+    std::vector<std::shared_ptr<connection_interface>> conns;
+    std::vector<std::shared_ptr<BTRequestStream>> streams;
+    for (size_t i = 0; i < num_conns; i++)
+    {
+        log::debug(test_cat, "Connecting to {}...", server_addr);
+        auto& c = conns.emplace_back(client->connect(server_addr, client_tls));
+        for (size_t j = 0; j < num_streams; j++)
+            streams.push_back(c->open_stream<BTRequestStream>());
+    }
+
+    // Requests are only ever issued and completed on the event loop (the initial ones of each run
+    // through `call`, the rest from response callbacks), so the run state needs no locking.
+    struct run_state
+    {
+        explicit run_state(uint64_t total) : total{total} {}
+
+        uint64_t total;
+        uint64_t issued = 0;
+        uint64_t completed = 0;
+        uint64_t errors = 0;
+        std::vector<std::chrono::nanoseconds> rtts;
+        std::promise<void> done;
+    };
+
+    // Each in-flight slot issues its next request as soon as the previous one completes
+    std::function<void(run_state&, BTRequestStream&)> issue = [&](run_state& run, BTRequestStream& s) {
+        if (run.issued == run.total)
+            return;
+        run.issued++;
+        auto sent = std::chrono::steady_clock::now();
+        s.command(endpoint, std::string_view{body}, [&run, &s, &issue, sent](message m) {
+            auto rtt = std::chrono::steady_clock::now() - sent;
+            if (m)
+                run.rtts.push_back(rtt);
+            else
+                run.errors++;
+            if (++run.completed == run.total)
+                run.done.set_value();
+            else
+                issue(run, s);
+        });
+    };
+
+    auto do_run = [&](run_state& run) {
+        run.rtts.reserve(run.total);
+        auto fut = run.done.get_future();
+        if (run.total == 0)
+            return;
+        client_net.call([&] {
+            for (size_t c = 0; c < num_conns; c++)
+                for (size_t i = 0; i < concurrency; i++)
+                    issue(run, *streams[c * num_streams + i % num_streams]);
+        });
+        fut.get();
+    };
+
+    // The warmup gets the connections established (and the server's streams constructed) before
+    // we start timing.
+    run_state warm{std::max<uint64_t>(warmup, num_conns * concurrency)};
+    do_run(warm);
+    if (warm.errors)
+        log::warning(test_cat, "{} warmup requests failed", warm.errors);
+
+    run_state run{num_requests};
+    auto started_at = std::chrono::steady_clock::now();
+    do_run(run);
+    auto elapsed = std::chrono::duration<double>{std::chrono::steady_clock::now() - started_at}.count();
+
+    auto& rtts = run.rtts;
+    std::sort(rtts.begin(), rtts.end());
+    auto percentile = [&rtts](double p) {
+        auto i = static_cast<size_t>(std::ceil(p * rtts.size()));
+        return std::chrono::duration<double, std::micro>{rtts[i > 0 ? i - 1 : 0]}.count();
+    };
+
+    fmt::print(
+            "{} requests ({}B request, {}B response) over {} connection(s) x {} stream(s), {} in flight per "
+            "connection\n",
+            run.total,
+            body.size(),
+            resp_size.value_or(body.size()),
+            num_conns,
+            num_streams,
+            concurrency);
+    fmt::print("Elapsed time: {:.3f}s\n", elapsed);
+    fmt::print("Rate: {:.1f} requests/s\n", run.completed / elapsed);
+    if (run.errors)
+        fmt::print("Errors: {}\n", run.errors);
+    if (!rtts.empty())
+        fmt::print(
+                "RTT (µs): min {:.1f}, p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, p999 {:.1f}, max {:.1f}\n",
+                percentile(0),
+                percentile(0.5),
+                percentile(0.9),
+                percentile(0.99),
+                percentile(0.999),
+                percentile(1));
+
+    for (auto& c : conns)
+        c->close_connection();
+    std::this_thread::sleep_for(100ms);
+
+    return run.errors ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/*
+    BT RPC benchmark server: answers the requests of bt-rpc-bench-client
+*/
+
+#include <oxenc/endian.h>
+
+#include <CLI/Validators.hpp>
+#include <oxen/quic.hpp>
+#include <oxen/quic/gnutls_crypto.hpp>
+#include <thread>
+
+#include "utils.hpp"
+
+using namespace oxen::quic;
+
+int main(int argc, char* argv[])
+{
+    CLI::App cli{"libQUIC BT RPC benchmark server"};
+
+    std::string server_addr = "127.0.0.1:5500";
+
+    cli.add_option("--listen", server_addr, "Server address to listen on")->type_name("IP:PORT")->capture_default_str();
+
+    std::string log_file, log_level;
+    add_log_opts(cli, log_file, log_level);
+
+    size_t workers = 0;
+    cli.add_option(
+               "-w,--workers",
+               workers,
+               "Run request handlers on a pool of this many worker threads instead of on the event loop")
+            ->capture_default_str();
+
+    bool cork = false;
+    cli.add_flag("--cork", cork, "Enable auto-corking of responses on the server's streams");
+
+    try
+    {
+        cli.parse(argc, argv);
+    }
+    catch (const CLI::ParseError& e)
+    {
+        return cli.exit(e);
+    }
+
+    setup_logging(log_file, log_level);
+
+    auto [seed, pubkey] = generate_ed25519();
+    auto server_tls = GNUTLSCreds::make_from_ed_keys(seed, pubkey);
+
+    Network server_net{};
+
+    auto [listen_addr, listen_port] = parse_addr(server_addr, 5500);
+    Address server_local{listen_addr, listen_port};
+
+    std::shared_ptr<bt_worker_pool> pool;
+    if (workers > 0)
+        pool = std::make_shared<bt_worker_pool>(workers);
+
+    // "echo" responds with the request body; "sized" responds with as many bytes as the
+    // little-endian uint64_t at the start of the request body asks for.
+    auto router = std::make_shared<const bt_router>(std::vector<std::pair<std::string, bt_router::handler>>{
+            {"echo", [](message m) { m.respond(m.body()); }},
+            {"sized", [](message m) {
+                 auto body = m.body();
+                 if (body.size() < sizeof(uint64_t))
+                     return m.respond("sized request body too short"sv, true);
+                 auto size = oxenc::load_little_to_host<uint64_t>(body.data());
+                 m.respond(std::string(size, 'r'));
+             }}});
+
+    stream_constructor_callback constructor =
+            [&](Connection& c, Endpoint& e, std::optional<int64_t>) -> std::shared_ptr<Stream> {
+        auto s = pool ? e.make_shared<BTRequestStream>(c, e, router, pool) : e.make_shared<BTRequestStream>(c, e, router);
+        if (cork)
+            s->set_auto_cork(true);
+        return s;
+    };
+
+    try
+    {
+        log::debug(test_cat, "Starting up endpoint");
+        auto _server = server_net.endpoint(server_local);
+        _server->listen(server_tls, constructor);
+    }
+    catch (const std::exception& e)
+    {
+        log::critical(test_cat, "Failed to start server: {}!", e.what());
+        return 1;
+    }
+
+    {
+        // As in speedtest-server, always show the arguments the client needs
+        log_level_lowerer enable_info{log::Level::info, test_cat.name};
+        std::vector<std::string> flags;
+        if (server_local != Address{"127.0.0.1", 5500})
+            flags.push_back("--remote {}"_format(server_local.to_string()));
+        flags.push_back("--remote-pubkey={}"_format(oxenc::to_base64(pubkey)));
+
+        log::info(
+                test_cat,
+                "Listening on {}; client connection args:\n\t{}",
+                server_local,
+                "{}"_format(fmt::join(flags, " ")));
+    }
+
+    for (;;)
+        std::this_thread::sleep_for(10min);
+}
@@ -50,6 +50,11 @@ int main(int argc, char* argv[])
     size_t dgram_size = 0;
     cli.add_option("--dgram-size", dgram_size, "Datagram size to send");
 
+    uint64_t batch = 1;
+    cli.add_option("--batch", batch, "Queue datagrams in batches of this many (via send_datagrams); 1 sends individually")
+            ->check(CLI::Range(1, 10000))
+            ->capture_default_str();
+
     try
     {
         cli.parse(argc, argv);
@@ -177,10 +182,20 @@ int main(int argc, char* argv[])
 
         started_at = std::chrono::steady_clock::now();
 
-        for (uint64_t i = 1; i < d_ptr->n_iter; ++i)
+        if (batch > 1)
+        {
+            std::vector<bstring_view> batch_views(batch, convert_sv<std::byte>(ustring_view{d_ptr->msg}));
+            for (uint64_t i = 1; i < d_ptr->n_iter; i += batch)
+                client_ci->send_datagrams(
+                        std::span<const bstring_view>{batch_views.data(), std::min(batch, d_ptr->n_iter - i)});
+        }
+        else
         {
-            // Just send these with the 0 at the beginning
-            client_ci->send_datagram(ustring_view{d_ptr->msg});
+            for (uint64_t i = 1; i < d_ptr->n_iter; ++i)
+            {
+                // Just send these with the 0 at the beginning
+                client_ci->send_datagram(ustring_view{d_ptr->msg});
+            }
         }
         // Send a final one with the max value in the beginning so the server knows its done
         ustring last_payload{d_ptr->msg};
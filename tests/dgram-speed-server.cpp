@@ -65,7 +65,7 @@ int main(int argc, char* argv[])
 
     std::shared_ptr<Endpoint> server;
 
-    dgram_data_callback recv_dgram_cb = [&](dgram_interface& di, bstring_view data) {
+    dgram_view_callback recv_dgram_cb = [&](dgram_interface& di, bstring_view data) {
         if (dgram_data.n_expected == 0)
         {
             // The very first packet should be 8 bytes containing the uint64_t count of total
@@ -117,7 +117,7 @@ int main(int argc, char* argv[])
         log::debug(test_cat, "Starting up endpoint");
         auto split_dgram = opt::enable_datagrams(Splitting::ACTIVE);
         // opt::enable_datagrams split_dgram(Splitting::ACTIVE);
-        server = server_net.endpoint(server_local, recv_dgram_cb, split_dgram);
+        server = server_net.endpoint(server_local, opt::dgram_views{recv_dgram_cb}, split_dgram);
         server->listen(server_tls, stream_opened);
     }
     catch (const std::exception& e)
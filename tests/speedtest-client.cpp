@@ -2,7 +2,15 @@
     Test client binary
 */
 
+#include <fcntl.h>
 #include <oxenc/endian.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include <CLI/Validators.hpp>
 #include <chrono>
@@ -80,6 +88,21 @@ int main(int argc, char* argv[])
     cli.add_option("--stream-chunk-size", chunk_size, "How much data to queue at once, per chunk");
     cli.add_option("--stream-chunks", chunk_num, "How much chunks to queue at once per stream")->check(CLI::Range(1, 100));
 
+    std::string file;
+    cli.add_option(
+               "-f,--file",
+               file,
+               "Send the contents of the given file instead of generated data (--size is ignored).  With --parallel the "
+               "file is divided equally across streams.  The file is hashed before the transfer starts.")
+            ->check(CLI::ExistingFile);
+
+    bool file_read = false;
+    cli.add_flag(
+            "--file-read",
+            file_read,
+            "When sending a --file, read it chunk-by-chunk into memory and send that (as with generated data) instead of "
+            "using zero-copy Stream::send_file (always enabled on Windows, where send_file is not available)");
+
     size_t rng_seed = 0;
     cli.add_option(
             "--rng-seed",
@@ -95,6 +118,11 @@ int main(int argc, char* argv[])
         return cli.exit(e);
     }
 
+#ifdef _WIN32
+    // Stream::send_file is POSIX-only, so on Windows a --file is always sent by reading it into memory
+    file_read = true;
+#endif
+
     using RNG = std::mt19937_64;
 
     struct stream_data
@@ -109,6 +137,7 @@ int main(int argc, char* argv[])
         std::future<void> running = run_prom.get_future();
         std::atomic<bool> failed = false;
         size_t next_buf = 0;
+        uint64_t file_offset = 0;
 
         std::basic_string<std::byte> hash;
         uint8_t checksum = 0;
@@ -133,6 +162,26 @@ int main(int argc, char* argv[])
 
     setup_logging(log_file, log_level);
 
+    int file_fd = -1;
+    if (!file.empty())
+    {
+#ifdef _WIN32
+        file_fd = _open(file.c_str(), _O_RDONLY | _O_BINARY);
+        struct _stat64 st;
+        if (file_fd < 0 || _fstat64(file_fd, &st) != 0)
+#else
+        file_fd = open(file.c_str(), O_RDONLY);
+        struct stat st;
+        if (file_fd < 0 || fstat(file_fd, &st) != 0)
+#endif
+        {
+            log::critical(test_cat, "Unable to open {}: {}", file, strerror(errno));
+            return 1;
+        }
+        size = st.st_size;
+        pregenerate = false;
+    }
+
     Network client_net{};
 
     auto [seed, pubkey] = generate_ed25519();
@@ -221,8 +270,49 @@ int main(int argc, char* argv[])
 
     auto per_stream = size / parallel;
 
+    auto hash_data = [no_hash, no_checksum](
+                             const std::vector<std::byte>& data, gnutls_hash_hd_t& hasher, uint8_t& checksum) {
+        if (!no_checksum)
+        {
+            uint64_t csum = 0;
+            const uint64_t* stuff = reinterpret_cast<const uint64_t*>(data.data());
+            for (size_t i = 0; i < data.size() / 8; i++)
+                csum ^= stuff[i];
+            for (int i = 0; i < 8; i++)
+                checksum ^= reinterpret_cast<const uint8_t*>(&csum)[i];
+            for (size_t i = data.size() & ~0b111; i < data.size(); i++)
+                checksum ^= static_cast<uint8_t>(data[i]);
+        }
+
+        if (!no_hash)
+            gnutls_hash(hasher, reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    };
+
+    // Reads the next chunk of a stream's file slice into `data`; returns false on error.
+    auto read_file = [&file_fd](uint64_t offset, size_t size, std::vector<std::byte>& data) {
+        data.resize(size);
+        for (size_t pos = 0; pos < size;)
+        {
+#ifdef _WIN32
+            // No pread on Windows; this is only ever called from one thread at a time so seek + read is fine.
+            auto n = _lseeki64(file_fd, offset + pos, SEEK_SET) < 0
+                           ? -1
+                           : _read(file_fd, data.data() + pos, static_cast<unsigned int>(size - pos));
+#else
+            auto n = pread(file_fd, data.data() + pos, size - pos, offset + pos);
+#endif
+            if (n <= 0)
+            {
+                log::critical(test_cat, "Failed to read file: {}", n < 0 ? strerror(errno) : "unexpected EOF");
+                return false;
+            }
+            pos += n;
+        }
+        return true;
+    };
+
     auto gen_data =
-            [no_hash, no_checksum](
+            [&hash_data](
                     RNG& rng, size_t size, std::vector<std::byte>& data, gnutls_hash_hd_t& hasher, uint8_t& checksum) {
                 assert(size > 0);
 
@@ -245,34 +335,40 @@ int main(int argc, char* argv[])
                 data.resize(size);
 
                 // Hash/checksum it (so that we can verify the hash response at the end)
-                if (!no_checksum)
-                {
-                    uint64_t csum = 0;
-                    const uint64_t* stuff = reinterpret_cast<const uint64_t*>(data.data());
-                    for (size_t i = 0; i < data.size() / 8; i++)
-                        csum ^= stuff[i];
-                    for (int i = 0; i < 8; i++)
-                        checksum ^= reinterpret_cast<const uint8_t*>(&csum)[i];
-                    for (size_t i = data.size() & ~0b111; i < data.size(); i++)
-                        checksum ^= static_cast<uint8_t>(data[i]);
-                }
-
-                if (!no_hash)
-                    gnutls_hash(hasher, reinterpret_cast<unsigned char*>(data.data()), data.size());
+                hash_data(data, hasher, checksum);
             };
 
     if (pregenerate)
     {
         log::warning(test_cat, "Pregenerating data...");
     }
+    else if (file_fd >= 0)
+    {
+        log::warning(test_cat, "Hashing {} ({}B)...", file, size);
+    }
 
+    uint64_t next_offset = 0;
     for (size_t i = 0; i < parallel; i++)
     {
         uint64_t my_data = per_stream + (i == 0 ? size % parallel : 0);
         auto& s = *streams.emplace_back(std::make_unique<stream_data>(
                 my_data, rng_seed + i, pregenerate ? my_data : chunk_size, pregenerate ? 1 : chunk_num));
+        s.file_offset = next_offset;
+        next_offset += my_data;
 
-        if (pregenerate)
+        if (file_fd >= 0)
+        {
+            auto& buf = s.bufs[0];
+            for (uint64_t pos = 0; pos < my_data; pos += chunk_size)
+            {
+                if (!read_file(s.file_offset + pos, std::min<uint64_t>(chunk_size, my_data - pos), buf))
+                    return 1;
+                hash_data(buf, s.sent_hasher, s.checksum);
+            }
+            s.hash.resize(32);
+            gnutls_hash_output(s.sent_hasher, reinterpret_cast<unsigned char*>(s.hash.data()));
+        }
+        else if (pregenerate)
         {
             gen_data(s.rng, my_data, s.bufs[0], s.sent_hasher, s.checksum);
             s.hash.resize(32);
@@ -300,6 +396,44 @@ int main(int argc, char* argv[])
             s.done_sending = true;
             s.stream->send(bstring_view{s.bufs[0].data(), s.bufs[0].size()});
         }
+#ifndef _WIN32
+        else if (file_fd >= 0 && !file_read)
+        {
+            s.done_sending = true;
+            s.stream->send_file(file_fd, s.file_offset, s.remaining);
+            s.remaining = 0;
+        }
+#endif
+        else if (file_fd >= 0)
+        {
+            s.stream->send_chunks(
+                    [&, i](const Stream&) -> std::vector<std::byte>* {
+                        auto& sd = *streams[i];
+                        auto& data = sd.bufs[sd.next_buf++];
+                        sd.next_buf %= sd.bufs.size();
+
+                        const auto size = std::min(sd.remaining, chunk_size);
+                        if (size == 0)
+                            return nullptr;
+
+                        if (!read_file(sd.file_offset, size, data))
+                        {
+                            sd.failed = true;
+                            sd.done = true;
+                            sd.run_prom.set_value();
+                            return nullptr;
+                        }
+
+                        sd.file_offset += size;
+                        sd.remaining -= size;
+                        if (sd.remaining == 0)
+                            sd.done_sending = true;
+
+                        return &data;
+                    },
+                    nullptr,
+                    chunk_num);
+        }
         else
         {
             s.stream->send_chunks(
@@ -363,5 +497,12 @@ int main(int argc, char* argv[])
     fmt::print("Elapsed time: {:.3f}s\n", elapsed);
     fmt::print("Speed: {:.3f}MB/s\n", size / 1'000'000.0 / elapsed);
 
+    if (file_fd >= 0)
+#ifdef _WIN32
+        _close(file_fd);
+#else
+        close(file_fd);
+#endif
+
     return 0;
 }
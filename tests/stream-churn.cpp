@@ -0,0 +1,141 @@
+/*
+    Stream churn benchmark: opens, uses, and closes many short-lived streams over a single local connection, reporting
+    stream throughput and the object pool statistics of the network's event loop.
+*/
+
+#include <CLI/Validators.hpp>
+#include <future>
+#include <oxen/quic.hpp>
+#include <oxen/quic/gnutls_crypto.hpp>
+#include <thread>
+
+#include "utils.hpp"
+
+using namespace oxen::quic;
+
+int main(int argc, char* argv[])
+{
+    CLI::App cli{"libQUIC stream churn benchmark"};
+
+    uint64_t num_streams = 10'000;
+    cli.add_option("-n,--streams", num_streams, "Total number of streams to open and close")->capture_default_str();
+
+    uint64_t batch = 1;
+    cli.add_option("-b,--batch", batch, "Number of streams to have open concurrently")
+            ->check(CLI::Range(1, 100))
+            ->capture_default_str();
+
+    uint64_t size = 32;
+    cli.add_option("-S,--size", size, "Size of the message sent (and echoed back) on each stream")
+            ->capture_default_str();
+
+    bool bt = false;
+    cli.add_flag("--bt", bt, "Use BTRequestStreams (one request/response per stream) instead of plain Streams");
+
+    std::string log_file, log_level;
+    add_log_opts(cli, log_file, log_level);
+
+    try
+    {
+        cli.parse(argc, argv);
+    }
+    catch (const CLI::ParseError& e)
+    {
+        return cli.exit(e);
+    }
+
+    setup_logging(log_file, log_level);
+
+    Network net{};
+
+    auto [client_tls, server_tls] = test::defaults::tls_creds_from_ed_keys();
+
+    stream_data_callback echo = [](Stream& s, bstring_view data) {
+        s.send(data);
+        s.close();
+    };
+
+    stream_constructor_callback server_constructor =
+            [&](Connection& c, Endpoint& e, std::optional<int64_t>) -> std::shared_ptr<Stream> {
+        if (!bt)
+            return e.make_shared<Stream>(c, e, echo);
+        auto s = e.make_shared<BTRequestStream>(c, e);
+        s->register_handler("echo", [](message m) { m.respond(m.body()); });
+        return s;
+    };
+
+    auto server = net.endpoint(Address{});
+    server->listen(server_tls, server_constructor, opt::max_streams{batch * 2});
+
+    auto client = net.endpoint(Address{});
+    auto conn = client->connect(
+            RemoteAddress{test::defaults::SERVER_PUBKEY, "127.0.0.1"s, server->local().port()},
+            client_tls,
+            opt::max_streams{batch * 2});
+
+    const std::string payload(size, 'x');
+
+    // Warm up: get the connection established (and the pools populated) before we start timing
+    {
+        std::promise<void> p;
+        auto s = conn->open_stream<Stream>([&](Stream&, bstring_view) { p.set_value(); });
+        s->send(std::string_view{payload});
+        p.get_future().get();
+        s->close();
+    }
+
+    auto stats_before = net.pool_stats();
+    auto started = std::chrono::steady_clock::now();
+
+    for (uint64_t done = 0; done < num_streams;)
+    {
+        auto n = std::min(batch, num_streams - done);
+        std::vector<std::promise<void>> replies(n);
+        std::vector<std::shared_ptr<Stream>> streams;
+        streams.reserve(n);
+
+        for (uint64_t i = 0; i < n; i++)
+        {
+            auto& p = replies[i];
+            if (bt)
+            {
+                auto s = conn->open_stream<BTRequestStream>();
+                s->command("echo", std::string_view{payload}, [&p](message) { p.set_value(); });
+                streams.push_back(std::move(s));
+            }
+            else
+            {
+                auto s = conn->open_stream<Stream>([&p](Stream&, bstring_view) { p.set_value(); });
+                s->send(std::string_view{payload});
+                streams.push_back(std::move(s));
+            }
+        }
+
+        for (auto& p : replies)
+            p.get_future().get();
+        for (auto& s : streams)
+            s->close();
+
+        done += n;
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    auto stats_after = net.pool_stats();
+
+    fmt::print(
+            "{} {}streams in {:.3f}s: {:.1f} streams/s\n",
+            num_streams,
+            bt ? "BTRequest" : "",
+            elapsed,
+            num_streams / elapsed);
+    fmt::print(
+            "pool: {} allocations ({} reused), {} new slabs ({} B total reserved), {} chunks in use\n",
+            stats_after.allocs - stats_before.allocs,
+            stats_after.reused - stats_before.reused,
+            stats_after.slabs - stats_before.slabs,
+            stats_after.reserved,
+            stats_after.in_use);
+
+    conn->close_connection();
+    std::this_thread::sleep_for(100ms);
+}
@@ -2,6 +2,8 @@
 
 #include <nettle/eddsa.h>
 
+#include <oxen/quic/btstream.hpp>
+
 namespace oxen::quic
 {
     void TestHelper::migrate_connection(Connection& conn, Address new_bind)
@@ -107,6 +109,11 @@ namespace oxen::quic
         return conn._endpoint.call_get([&conn] { return conn.debug_datagram_counter; });
     }
 
+    uint64_t TestHelper::get_bt_send_count(BTRequestStream& s)
+    {
+        return s.endpoint.call_get([&s] { return s.debug_send_count; });
+    }
+
     void TestHelper::increment_ref_id(Endpoint& ep, uint64_t by)
     {
         ep._next_rid += by;
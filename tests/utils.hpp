@@ -32,6 +32,8 @@ namespace oxen::quic
     inline const std::string TEST_ENDPOINT = "test_endpoint"s;
     inline const std::string TEST_BODY = "test_body"s;
 
+    class BTRequestStream;
+
     class TestHelper
     {
       public:
@@ -54,6 +56,10 @@ namespace oxen::quic
         static void increment_ref_id(Endpoint& ep, uint64_t by = 1);
 
         static Connection* get_conn(std::shared_ptr<Endpoint>& ep, std::shared_ptr<connection_interface>& conn);
+
+        // Returns the number of sends a BTRequestStream has made into its stream (each of which may
+        // carry several merged messages)
+        static uint64_t get_bt_send_count(BTRequestStream& s);
     };
 
     namespace test::defaults